@@ -0,0 +1,1230 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+#include "buffer_arena.h"
+#include "bvh.h"
+#include "camera.h"
+#include "camera_path.h"
+#include "context.h"
+#include "culling.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "indirect_draws.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "shader_batch.h"
+#include "software_renderer.h"
+#include "stream_buffer.h"
+#include "transform.h"
+#include "uniform_name.h"
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+// allocation-counting hook: every global operator new in learnopengl_bench lands here
+static std::atomic<size_t> heapAllocations(0);
+
+void* operator new(size_t size) {
+	heapAllocations++;
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+const int BENCH_WIDTH = 1280;
+const int BENCH_HEIGHT = 720;
+const float BENCH_TIMESTEP = 1.0f / 60.0f;
+
+struct BenchOptions {
+	ContextBackend backend = BACKEND_HEADLESS;
+	int frames = 300;
+	int warmup = 30;
+	int maxInstances = 1000000;
+	// largest object count of the bvh benchmark
+	int maxObjects = 10000000;
+	// frames: save the scripted camera, or drive the camera from a saved path instead
+	const char* recordPath = nullptr;
+	const char* replayPath = nullptr;
+};
+
+static double msSince(BenchClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// same input sequence every run: sweep the view sideways and walk back and forth
+static void scriptCamera(Camera &cam, int frame, CameraRecorder *recorder = nullptr) {
+	float pitch = (frame / 90) % 2 == 0 ? 0.5f : -0.5f;
+	MoveDirection dir = (frame / 120) % 2 == 0 ? FORWARD : BACKWORD;
+	cam.rotate(2.0f, pitch);
+	cam.translate(dir, BENCH_TIMESTEP);
+	if (recorder) {
+		recorder->rotate(2.0f, pitch);
+		recorder->translate(dir, BENCH_TIMESTEP);
+	}
+}
+
+// uniforms still uploaded by name, camera and light state live in uniform blocks
+static const char* boxFrameUniforms[] = {
+	"material.diffuse", "material.specular", "material.shininess"
+};
+
+// compare driver string lookups against the cached table and pre-resolved handles
+static void benchUniforms(Scene &scene, const BenchOptions &) {
+	const Shader &shader = scene.getBoxShader();
+	const int iterations = 10000;
+	const int count = (int)std::size(boxFrameUniforms);
+	std::string names[std::size(boxFrameUniforms)];
+	// read back every time, otherwise the handle loop folds into one multiply
+	volatile GLint handles[std::size(boxFrameUniforms)];
+	for (int i = 0; i < count; i++) {
+		names[i] = boxFrameUniforms[i];
+		handles[i] = shader.getUniformLocation(names[i]);
+	}
+
+	GLint sink = 0;
+	auto t0 = BenchClock::now();
+	for (int n = 0; n < iterations; n++)
+		for (int i = 0; i < count; i++)
+			sink += glGetUniformLocation(shader.id, names[i].c_str());
+	auto t1 = BenchClock::now();
+	for (int n = 0; n < iterations; n++)
+		for (int i = 0; i < count; i++)
+			sink += shader.getUniformLocation(names[i]);
+	auto t2 = BenchClock::now();
+	for (int n = 0; n < iterations; n++)
+		for (int i = 0; i < count; i++)
+			sink += handles[i];
+	auto t3 = BenchClock::now();
+
+	double lookups = (double)iterations * count;
+	auto nsPer = [lookups](BenchClock::duration d) {
+		return std::chrono::duration<double, std::nano>(d).count() / lookups;
+	};
+	std::cout << "[uniforms] lookup of " << count << " names x " << iterations << ": "
+		<< "glGetUniformLocation " << nsPer(t1 - t0) << " ns, "
+		<< "cached table " << nsPer(t2 - t1) << " ns, "
+		<< "handle " << nsPer(t3 - t2) << " ns (" << sink << ")" << std::endl;
+
+	// one frame through the scene, the camera and lights are uniform blocks
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	Shader::resetStats();
+	scene.render(cam);
+	std::cout << "[uniforms] scene frame: " << Shader::stats.uniformUploads << " uploads, "
+		<< Shader::stats.locationQueries << " glGetUniformLocation" << std::endl;
+
+	// the material as a frame used to set it, by name: through the cached
+	// table, then with a driver lookup before every upload as before the cache
+	const int frames = 1000;
+	GLState::useProgram(shader.id);
+	Shader::resetStats();
+	t0 = BenchClock::now();
+	for (int n = 0; n < frames; n++) {
+		shader.setInt(boxFrameUniforms[0], 0);
+		shader.setInt(boxFrameUniforms[1], 1);
+		shader.setFloat(boxFrameUniforms[2], 32.0f);
+	}
+	t1 = BenchClock::now();
+	Shader::Stats cached = Shader::stats;
+	unsigned int driverQueries = 0, driverUploads = 0;
+	auto location = [&shader, &driverQueries](const char* name) {
+		driverQueries++;
+		return glGetUniformLocation(shader.id, name);
+	};
+	for (int n = 0; n < frames; n++) {
+		glUniform1i(location(boxFrameUniforms[0]), 0);
+		glUniform1i(location(boxFrameUniforms[1]), 1);
+		glUniform1f(location(boxFrameUniforms[2]), 32.0f);
+		driverUploads += 3;
+	}
+	t2 = BenchClock::now();
+	auto usPerFrame = [frames](BenchClock::duration d) {
+		return std::chrono::duration<double, std::micro>(d).count() / frames;
+	};
+	std::cout << "[uniforms] material by name per frame: cached " << cached.uniformUploads / frames << " uploads, "
+		<< cached.locationQueries / frames << " glGetUniformLocation, " << usPerFrame(t1 - t0) << " us; uncached "
+		<< driverUploads / frames << " uploads, " << driverQueries / frames << " glGetUniformLocation, "
+		<< usPerFrame(t2 - t1) << " us" << std::endl;
+}
+
+// fixed-length scripted run, every frame is finished before the clock stops;
+// with --replay the camera follows a recorded path at BENCH_TIMESTEP instead
+static void benchFrames(Scene &scene, const BenchOptions &options) {
+	CameraPath path;
+	if (options.replayPath && !path.load(options.replayPath))
+		return;
+	CameraPlayer player(path, BENCH_TIMESTEP);
+	const bool replay = options.replayPath != nullptr;
+	const int frames = replay ? player.getFrameCount() : options.frames;
+
+	// a replay warms up on its own first frames and starts over
+	Camera cam = replay ? player.start() : Camera(glm::vec3(0.0f, 0.0f, -3.0f));
+	for (int i = 0; i < options.warmup; i++) {
+		if (replay)
+			player.step(cam);
+		else
+			scriptCamera(cam, i);
+		scene.render(cam);
+	}
+	glFinish();
+	if (replay)
+		cam = player.start();
+	CameraRecorder recorder(cam);
+
+	std::vector<double> frameMs;
+	frameMs.reserve(frames);
+	auto start = BenchClock::now();
+	for (int i = 0; i < frames; i++) {
+		auto frameStart = BenchClock::now();
+		recorder.setTime(i * BENCH_TIMESTEP);
+		if (replay)
+			player.step(cam);
+		else
+			scriptCamera(cam, options.warmup + i, options.recordPath ? &recorder : nullptr);
+		scene.render(cam);
+		glFinish();
+		frameMs.push_back(msSince(frameStart));
+	}
+	double total = msSince(start);
+
+	double minMs = frameMs.empty() ? 0.0 : frameMs[0];
+	double maxMs = minMs;
+	for (double ms : frameMs) {
+		if (ms < minMs) minMs = ms;
+		if (ms > maxMs) maxMs = ms;
+	}
+	std::cout << "[frames] " << frames << " frames in " << total << " ms: avg "
+		<< total / frames << " ms, min " << minMs << " ms, max " << maxMs << " ms, "
+		<< 1000.0 * frames / total << " fps" << (replay ? " (replayed)" : "") << std::endl;
+	if (options.recordPath && !replay && recorder.getPath().save(options.recordPath))
+		std::cout << "[frames] camera path saved to " << options.recordPath << std::endl;
+}
+
+// cube grid filling the view of the default camera, which looks down +x
+static std::vector<glm::mat4> cubeGrid(int count) {
+	int side = (int)std::ceil(std::cbrt((double)count));
+	std::vector<glm::mat4> models;
+	models.reserve(count);
+	for (int i = 0; i < count; i++) {
+		int x = i / (side * side);
+		int y = (i / side) % side;
+		int z = i % side;
+		glm::vec3 pos(2.0f + x * 1.5f, (y - side / 2) * 1.5f, -3.0f + (z - side / 2) * 1.5f);
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
+		model = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
+		models.push_back(model);
+	}
+	return models;
+}
+
+// every box goes through one glDrawElementsInstanced, sweep the instance count
+static void benchInstances(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 20 ? options.frames : 20;
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	for (int count = 1000; count <= options.maxInstances; count *= 10) {
+		scene.setBoxInstances(cubeGrid(count));
+		scene.render(cam);
+		glFinish();
+
+		auto start = BenchClock::now();
+		for (int i = 0; i < frames; i++) {
+			scene.render(cam);
+			glFinish();
+		}
+		double ms = msSince(start) / frames;
+		std::cout << "[instances] " << count << " boxes: " << ms << " ms/frame, "
+			<< ms * 1.0e6 / count << " ns/instance" << std::endl;
+	}
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+// a third each of rigid, uniformly scaled and non-uniformly scaled boxes
+static std::vector<InstanceData> mixedTransforms(int count) {
+	std::vector<glm::mat4> models = cubeGrid(count);
+	std::vector<InstanceData> instances(models.size());
+	for (size_t i = 0; i < models.size(); i++) {
+		glm::mat4 model = models[i];
+		if (i % 3 == 1)
+			model = glm::scale(model, glm::vec3(0.5f));
+		else if (i % 3 == 2)
+			model = glm::scale(model, glm::vec3(1.0f, 2.0f, 0.5f));
+		instances[i].model = model;
+	}
+	return instances;
+}
+
+// what shader_box.vs used to do per vertex, against the CPU paths run once per instance
+static void benchNormals(Scene &scene, const BenchOptions &options) {
+	std::vector<InstanceData> instances = mixedTransforms(options.maxInstances);
+	std::vector<InstanceData> reference = instances;
+	const double count = (double)instances.size();
+
+	auto t0 = BenchClock::now();
+	for (InstanceData &instance : reference)
+		instance.normal = glm::transpose(glm::inverse(glm::mat3(instance.model)));
+	auto t1 = BenchClock::now();
+	size_t rigid = computeNormalMatricesScalar(instances.data(), instances.size());
+	auto t2 = BenchClock::now();
+	computeNormalMatrices(instances.data(), instances.size());
+	auto t3 = BenchClock::now();
+
+	// the cofactor path differs from the inverse transpose by a positive scale only
+	float maxError = 0.0f;
+	for (size_t i = 0; i < instances.size(); i++) {
+		for (int k = 0; k < 3; k++) {
+			glm::vec3 a = glm::normalize(instances[i].normal * glm::vec3(k == 0, k == 1, k == 2));
+			glm::vec3 b = glm::normalize(reference[i].normal * glm::vec3(k == 0, k == 1, k == 2));
+			maxError = std::fmax(maxError, glm::length(a - b));
+		}
+	}
+
+	auto nsPer = [count](BenchClock::duration d) {
+		return std::chrono::duration<double, std::nano>(d).count() / count;
+	};
+	std::cout << "[normals] " << instances.size() << " instances (" << rigid << " rigid): "
+		<< "transpose(inverse) " << nsPer(t1 - t0) << " ns, "
+		<< "scalar " << nsPer(t2 - t1) << " ns, "
+		<< "simd " << nsPer(t3 - t2) << " ns per instance, max direction error " << maxError << std::endl;
+	std::cout << "[normals] shader_box.vs used to invert per vertex: "
+		<< 36 * scene.getBoxCount() << " inversions per frame for " << scene.getBoxCount() << " boxes" << std::endl;
+}
+
+// bytes the vertex stage fetches per cube, before and after welding and packing
+static void benchMesh(Scene &scene, const BenchOptions &) {
+	const Mesh &mesh = scene.getCubeMesh();
+	size_t expanded = mesh.getIndexCount() * 8 * sizeof(float);
+	size_t packed = mesh.getVertexBytes() + mesh.getIndexBytes();
+	std::cout << "[mesh] cube: " << mesh.getIndexCount() << " expanded vertices, " << expanded << " bytes -> "
+		<< mesh.getVertexCount() << " welded vertices + " << mesh.getIndexCount() << " indices, " << packed
+		<< " bytes (" << 100.0 * packed / expanded << "%)" << std::endl;
+}
+
+// an n x n quad grid in the xz plane, welded to (n + 1)^2 vertices
+static MeshData gridMesh(int n) {
+	std::vector<float> interleaved;
+	interleaved.reserve((size_t)n * n * 6 * 8);
+	for (int z = 0; z < n; z++) {
+		for (int x = 0; x < n; x++) {
+			const int corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+			for (const int *corner : corners) {
+				float u = (float)(x + corner[0]) / n, v = (float)(z + corner[1]) / n;
+				const float vertex[8] = { u - 0.5f, 0.0f, v - 0.5f, 0.0f, 1.0f, 0.0f, u, v };
+				interleaved.insert(interleaved.end(), vertex, vertex + 8);
+			}
+		}
+	}
+	return buildMesh(interleaved.data(), interleaved.size() / 8);
+}
+
+// the arena's bytes of every mesh match what was uploaded
+static size_t intactMeshes(const MeshArena &arena, const std::vector<std::unique_ptr<Mesh>> &meshes,
+	const std::vector<int> &sizes) {
+	size_t intact = 0;
+	std::vector<unsigned char> bytes;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		const Mesh &mesh = *meshes[i];
+		MeshData data = gridMesh(sizes[i]);
+		std::vector<unsigned short> indices(data.indices.begin(), data.indices.end());
+		bytes.resize(mesh.getVertexBytes() + mesh.getIndexBytes());
+		glBindBuffer(GL_COPY_READ_BUFFER, arena.getVertices().getBuffer());
+		glGetBufferSubData(GL_COPY_READ_BUFFER, mesh.getBaseVertex() * sizeof(PackedVertex), mesh.getVertexBytes(), bytes.data());
+		glBindBuffer(GL_COPY_READ_BUFFER, arena.getIndices().getBuffer());
+		glGetBufferSubData(GL_COPY_READ_BUFFER, mesh.getFirstIndex() * mesh.getIndexSize(), mesh.getIndexBytes(),
+			bytes.data() + mesh.getVertexBytes());
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		intact += memcmp(bytes.data(), data.vertices.data(), mesh.getVertexBytes()) == 0
+			&& memcmp(bytes.data() + mesh.getVertexBytes(), indices.data(), mesh.getIndexBytes()) == 0;
+	}
+	return intact;
+}
+
+static void printArena(const char *label, const MeshArena &arena, size_t meshes) {
+	const BufferArena *buffers[2] = { &arena.getVertices(), &arena.getIndices() };
+	const char *names[2] = { "vertices", "indices" };
+	std::cout << "[arena] " << label << ", " << meshes << " meshes" << std::endl;
+	for (int i = 0; i < 2; i++) {
+		const BufferArena::Stats &stats = buffers[i]->getStats();
+		std::cout << "[arena]   " << names[i] << ": " << stats.used / 1024 << " of " << stats.capacity / 1024
+			<< " KB used (" << 100.0f * buffers[i]->getUtilization() << "%), " << stats.freeBlocks << " free blocks, "
+			<< 100.0f * buffers[i]->getFragmentation() << "% fragmented, " << stats.grows << " grows, "
+			<< stats.defrags << " defrags, " << stats.bytesMoved / 1024 << " KB moved" << std::endl;
+	}
+}
+
+// grids of random size churned through a small arena: it grows, fills its
+// holes, gets defragmented, and every mesh must keep its bytes throughout
+static void benchArena(Scene &scene, const BenchOptions &options) {
+	const int count = options.maxObjects < 2000 ? options.maxObjects : 2000;
+	unsigned int seed = 777u;
+	auto next = [&seed](int range) {
+		seed = seed * 1664525u + 1013904223u;
+		return (int)((seed >> 8) % (unsigned int)range);
+	};
+	MeshArena arena(64 << 10, 16 << 10);
+	std::vector<std::unique_ptr<Mesh>> meshes;
+	std::vector<int> sizes;
+	auto start = BenchClock::now();
+	for (int i = 0; i < count; i++) {
+		sizes.push_back(1 + next(16));
+		meshes.emplace_back(new Mesh(arena, gridMesh(sizes.back())));
+	}
+	glFinish();
+	std::cout << "[arena] " << count << " meshes built and uploaded in " << msSince(start) << " ms" << std::endl;
+	printArena("filled", arena, meshes.size());
+
+	for (size_t i = meshes.size(); i-- > 0;) {
+		if (next(2)) {
+			meshes.erase(meshes.begin() + i);
+			sizes.erase(sizes.begin() + i);
+		}
+	}
+	printArena("every other freed", arena, meshes.size());
+
+	// smaller ones fill the holes, bigger ones make it defragment or grow
+	for (int i = 0; i < count / 4; i++) {
+		sizes.push_back(1 + next(24));
+		meshes.emplace_back(new Mesh(arena, gridMesh(sizes.back())));
+	}
+	printArena("refilled", arena, meshes.size());
+
+	for (size_t i = meshes.size(); i-- > 0;) {
+		if (next(3) == 0) {
+			meshes.erase(meshes.begin() + i);
+			sizes.erase(sizes.begin() + i);
+		}
+	}
+	start = BenchClock::now();
+	arena.defragment();
+	glFinish();
+	double defragMs = msSince(start);
+	printArena("a third freed, then defragmented", arena, meshes.size());
+	std::cout << "[arena] defragment " << defragMs << " ms, " << intactMeshes(arena, meshes, sizes) << " of "
+		<< meshes.size() << " meshes intact" << std::endl;
+	printArena("scene", scene.getMeshArena(), 1);
+}
+
+// small dim lights scattered through the cube grid, same layout every run
+static std::vector<PointLight> scatteredLights(int count, const std::vector<glm::mat4> &boxes) {
+	std::vector<PointLight> lights;
+	unsigned int seed = 12345u;
+	auto next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (float)(seed >> 8) / 16777216.0f;
+	};
+	for (int i = 0; i < count; i++) {
+		PointLight light;
+		glm::vec3 box = glm::vec3(boxes[i % boxes.size()][3]);
+		light.position = box + glm::vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f) * 1.5f;
+		light.ambient = glm::vec3(0.0f);
+		light.diffuse = glm::vec3(next(), next(), next()) * 0.3f;
+		light.specular = light.diffuse;
+		light.constant = 1.0f;
+		light.linear = 0.7f;
+		light.quadratic = 8.0f;
+		lights.push_back(light);
+	}
+	return lights;
+}
+
+// clustered shading: frame cost should follow lights per cluster, not the total light count
+static void benchLights(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 20 ? options.frames : 20;
+	std::vector<glm::mat4> boxes = cubeGrid(1000);
+	scene.setBoxInstances(boxes);
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	std::cout << "[lights] " << scene.getThreadPool().getWorkerCount() + 1 << " threads assign lights to "
+		<< CLUSTER_X << "x" << CLUSTER_Y << "x" << CLUSTER_Z << " clusters, per frame buffers "
+		<< (scene.getClusters().isStreamed() ? "in the stream buffer (glTexBufferRange)" : "orphaned and refilled") << std::endl;
+	for (int count = 1; count <= 4096; count *= 8) {
+		scene.setPointLights(scatteredLights(count, boxes));
+		scene.render(cam);
+		glFinish();
+
+		double assignMs = 0.0;
+		auto start = BenchClock::now();
+		for (int i = 0; i < frames; i++) {
+			scene.render(cam);
+			glFinish();
+			assignMs += scene.getClusters().getStats().assignMs;
+		}
+		double ms = msSince(start) / frames;
+		const LightClusters::Stats &stats = scene.getClusters().getStats();
+		std::cout << "[lights] " << count << " lights (" << stats.lightsInRange << " in depth range): "
+			<< ms << " ms/frame, assign " << assignMs / frames << " ms, "
+			<< stats.indices << " cluster entries, max " << stats.maxPerCluster << " per cluster" << std::endl;
+	}
+	scene.setPointLights(Scene::defaultPointLights());
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+static const char* benchTextureFiles[] = {
+	"textures/container_diffuse.png", "textures/container_specular.png",
+	"textures/container_emission.jpg", "textures/wood_container.jpg"
+};
+
+// each file several times over, decode and upload of one loader run
+static void runTextureLoader(Scene &scene, int copies, bool usePbo) {
+	std::vector<unsigned int> textures;
+	auto start = BenchClock::now();
+	double firstHandleMs = 0.0;
+	{
+		TextureLoader loader(scene.getDecodePool(), usePbo);
+		for (int n = 0; n < copies; n++)
+			for (const char* file : benchTextureFiles)
+				textures.push_back(loader.load(file));
+		firstHandleMs = msSince(start);
+		loader.finish();
+		glFinish();
+		const TextureLoader::Stats &stats = loader.getStats();
+		std::cout << "[textures] async" << (usePbo ? " + pbo" : "") << ": " << stats.uploaded << " textures in "
+			<< msSince(start) << " ms, handles after " << firstHandleMs << " ms, decode " << stats.decodeMs
+			<< " ms on workers, upload " << stats.uploadMs << " ms on gl thread ("
+			<< stats.uploadedBytes / (1024.0 * 1024.0) << " MiB)" << std::endl;
+	}
+	GLState::deleteTextures((GLsizei)textures.size(), textures.data());
+}
+
+// the old startup path against the pool: decode in parallel, upload as images arrive
+static void benchTextures(Scene &scene, const BenchOptions &) {
+	const int copies = 4;
+	std::vector<unsigned int> textures;
+	auto start = BenchClock::now();
+	for (int n = 0; n < copies; n++)
+		for (const char* file : benchTextureFiles)
+			textures.push_back(loadTexture(file));
+	glFinish();
+	std::cout << "[textures] " << scene.getDecodePool().getWorkerCount() << " decode workers" << std::endl;
+	std::cout << "[textures] loadTexture: " << textures.size() << " textures in " << msSince(start) << " ms" << std::endl;
+	GLState::deleteTextures((GLsizei)textures.size(), textures.data());
+
+	runTextureLoader(scene, copies, false);
+	runTextureLoader(scene, copies, true);
+}
+
+// driver calls the state shadow let through and dropped, per frame
+static void benchState(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 60 ? options.frames : 60;
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	scene.render(cam);
+	GLState::resetStats();
+	for (int i = 0; i < frames; i++)
+		scene.render(cam);
+	const GLState::Stats &stats = GLState::stats;
+	auto report = [frames](const char* name, const GLState::Counter &counter) {
+		std::cout << "[state] " << name << ": " << (double)counter.issued / frames << " issued, "
+			<< (double)counter.filtered / frames << " filtered per frame" << std::endl;
+	};
+	report("glUseProgram", stats.programs);
+	report("glBindVertexArray", stats.vertexArrays);
+	report("glBindTexture", stats.textures);
+	report("glEnable/glDisable", stats.capabilities);
+}
+
+static const char* pointLightMembers[] = {
+	".position", ".ambient", ".diffuse", ".specular", ".constant", ".linear", ".quadratic"
+};
+
+// indexed uniform names the old per-frame pLights loop built, with and without the heap
+static void benchAllocations(Scene &scene, const BenchOptions &) {
+	const Shader &shader = scene.getBoxShader();
+	const int lights = 1024;
+	GLint sink = 0;
+
+	size_t before = heapAllocations;
+	auto t0 = BenchClock::now();
+	for (int i = 0; i < lights; i++)
+		for (const char* member : pointLightMembers)
+			sink += shader.getUniformLocation("pLights[" + std::to_string(i) + "]" + member);
+	auto t1 = BenchClock::now();
+	size_t stringAllocations = heapAllocations - before;
+
+	before = heapAllocations;
+	auto t2 = BenchClock::now();
+	for (int i = 0; i < lights; i++)
+		for (const char* member : pointLightMembers)
+			sink += shader.getUniformLocation(UniformName<32>("pLights", i, member));
+	auto t3 = BenchClock::now();
+	size_t fixedAllocations = heapAllocations - before;
+
+	std::cout << "[allocations] " << lights << " lights x " << std::size(pointLightMembers) << " names: std::string "
+		<< stringAllocations << " allocations, " << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms; "
+		<< "UniformName " << fixedAllocations << " allocations, "
+		<< std::chrono::duration<double, std::milli>(t3 - t2).count() << " ms (" << sink << ")" << std::endl;
+
+	// steady state frames, with the default light and with a light per box
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	std::vector<glm::mat4> boxes = cubeGrid(lights);
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			scene.setBoxInstances(boxes);
+			scene.setPointLights(scatteredLights(lights, boxes));
+		}
+		for (int i = 0; i < 3; i++)
+			scene.render(cam);
+		glFinish();
+		before = heapAllocations;
+		for (int i = 0; i < 10; i++)
+			scene.render(cam);
+		glFinish();
+		size_t perFrame = (heapAllocations - before) / 10;
+		std::cout << "[allocations] frame with " << scene.getClusters().getLights().size() << " point lights: "
+			<< perFrame << " allocations" << (perFrame ? " (expected 0)" : "") << std::endl;
+	}
+	scene.setPointLights(Scene::defaultPointLights());
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+// cold builds with the cache switched off against warm loads of the same programs
+static void benchPrograms(Scene &, const BenchOptions &) {
+	const int rounds = 5;
+	if (!ProgramCache::isEnabled()) {
+		std::cout << "[programs] no program binary support, every build compiles" << std::endl;
+		return;
+	}
+	Shader::BuildStats before = Shader::buildStats;
+	ProgramCache::setEnabled(false);
+	for (int i = 0; i < rounds; i++) {
+		Shader box("shaders/shader_box.vs", "shaders/shader_box.fs");
+		Shader light("shaders/shader_light.vs", "shaders/shader_light.fs");
+		GLState::deleteProgram(box.id);
+		GLState::deleteProgram(light.id);
+	}
+	ProgramCache::setEnabled(true);
+	{
+		// make sure both binaries are on disk before timing the warm path
+		Shader box("shaders/shader_box.vs", "shaders/shader_box.fs");
+		Shader light("shaders/shader_light.vs", "shaders/shader_light.fs");
+		GLState::deleteProgram(box.id);
+		GLState::deleteProgram(light.id);
+	}
+	Shader::BuildStats cold = Shader::buildStats;
+	for (int i = 0; i < rounds; i++) {
+		Shader box("shaders/shader_box.vs", "shaders/shader_box.fs");
+		Shader light("shaders/shader_light.vs", "shaders/shader_light.fs");
+		GLState::deleteProgram(box.id);
+		GLState::deleteProgram(light.id);
+	}
+	const Shader::BuildStats &warm = Shader::buildStats;
+	unsigned int compiled = cold.compiled - before.compiled;
+	unsigned int loads = warm.cacheLoads - cold.cacheLoads;
+	std::cout << "[programs] compile from source: " << (cold.compileMs - before.compileMs) / compiled << " ms per program ("
+		<< compiled << " builds), cache load: " << (warm.cacheLoadMs - cold.cacheLoadMs) / (loads ? loads : 1)
+		<< " ms per program (" << loads << " hits of " << 2 * rounds << ")" << std::endl;
+}
+
+// one program after another with a status query after each compile, against a
+// batch that submits every build before the first query; the cache is off so both compile
+static void benchBatch(Scene &, const BenchOptions &) {
+	const int rounds = 5;
+	const char* paths[][2] = {
+		{ "shaders/shader_box.vs", "shaders/shader_box.fs" },
+		{ "shaders/shader_light.vs", "shaders/shader_light.fs" },
+		{ "shaders/shader_fallback.vs", "shaders/shader_fallback.fs" },
+	};
+	const size_t count = std::size(paths);
+	bool cacheEnabled = ProgramCache::isEnabled();
+	ProgramCache::setEnabled(false);
+
+	double sequentialMs = 0.0;
+	for (int r = 0; r < rounds; r++) {
+		auto start = BenchClock::now();
+		std::vector<Shader> shaders;
+		shaders.reserve(count);
+		for (size_t i = 0; i < count; i++)
+			shaders.emplace_back(paths[i][0], paths[i][1]);
+		sequentialMs += msSince(start);
+		for (Shader& shader : shaders)
+			GLState::deleteProgram(shader.id);
+	}
+
+	double submitMs = 0.0, batchMs = 0.0;
+	size_t polls = 0;
+	for (int r = 0; r < rounds; r++) {
+		auto start = BenchClock::now();
+		ShaderBatch batch;
+		std::vector<Shader> shaders;
+		shaders.reserve(count);
+		for (size_t i = 0; i < count; i++)
+			shaders.emplace_back(paths[i][0], paths[i][1], true);
+		for (Shader& shader : shaders)
+			batch.add(shader);
+		submitMs += msSince(start);
+		// what a render loop does: poll once per frame until everything is in
+		while (batch.poll() > 0)
+			polls++;
+		batchMs += msSince(start);
+		for (Shader& shader : shaders)
+			GLState::deleteProgram(shader.id);
+	}
+	ProgramCache::setEnabled(cacheEnabled);
+
+	std::cout << "[batch] parallel shader compile: " << (GLExt::hasParallelShaderCompile ? "yes" : "no") << std::endl;
+	std::cout << "[batch] " << count << " programs, sequential: " << sequentialMs / rounds << " ms, batched: "
+		<< batchMs / rounds << " ms (submit " << submitMs / rounds << " ms, "
+		<< (double)polls / rounds << " polls still pending)" << std::endl;
+}
+
+// frame cost of each lighting variant on a large box field with many point lights
+static void benchFeatures(Scene &scene, const BenchOptions &options) {
+	static const struct { const char* name; unsigned int features; } variants[] = {
+		{ "none", 0 },
+		{ "dir", FEATURE_DIR_LIGHT },
+		{ "spot", FEATURE_SPOT_LIGHT },
+		{ "point", FEATURE_POINT_LIGHTS },
+		{ "dir+point+spot", FEATURE_DEFAULT },
+		{ "all+emission", FEATURE_DEFAULT | FEATURE_EMISSION },
+	};
+	const int frames = options.frames < 50 ? options.frames : 50;
+	std::vector<glm::mat4> boxes = cubeGrid(10000);
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	scene.setBoxInstances(boxes);
+	scene.setPointLights(scatteredLights(256, boxes));
+	for (const auto& variant : variants) {
+		scene.setFeatures(variant.features);
+		scene.finishLoading();
+		scene.render(cam);
+		glFinish();
+		auto start = BenchClock::now();
+		for (int i = 0; i < frames; i++) {
+			scene.render(cam);
+			glFinish();
+		}
+		std::cout << "[features] " << variant.name << ": " << msSince(start) / frames << " ms/frame" << std::endl;
+	}
+	scene.setFeatures(FEATURE_DEFAULT);
+	scene.finishLoading();
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+	scene.setPointLights(Scene::defaultPointLights());
+}
+
+// boxes of random size and orientation filling a cube around the default camera,
+// only the few percent inside the view frustum touch the screen
+static std::vector<glm::mat4> scatteredBoxes(int count, float extent) {
+	std::vector<glm::mat4> models;
+	models.reserve(count);
+	unsigned int seed = 54321u;
+	auto next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (float)(seed >> 8) / 16777216.0f;
+	};
+	for (int i = 0; i < count; i++) {
+		glm::vec3 pos = glm::vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f) * 2.0f * extent;
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
+		model = glm::rotate(model, next() * 6.2831853f, glm::vec3(next(), next(), next()) + 0.1f);
+		models.push_back(glm::scale(model, glm::vec3(0.25f + next())));
+	}
+	return models;
+}
+
+// sphere culling throughput of every path, then frames of the stress scene with and without culling
+static void benchCulling(Scene &scene, const BenchOptions &options) {
+	const int rounds = 20;
+	const int frames = options.frames < 10 ? options.frames : 10;
+	std::vector<glm::mat4> boxes = scatteredBoxes(options.maxInstances, 100.0f);
+	BoundingSpheres spheres;
+	spheres.resize(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+		spheres.set(i, glm::vec3(boxes[i][3]), 0.8660254f * glm::length(glm::vec3(boxes[i][0])));
+	std::vector<unsigned int> visible(spheres.x.size()), reference(spheres.x.size());
+
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	glm::mat4 project = glm::perspective(glm::radians(cam.getFovY()), (float)BENCH_WIDTH / BENCH_HEIGHT, 0.1f, 100.0f);
+	Frustum frustum = extractFrustum(project * cam.getViewMat());
+	size_t expected = cullSpheres(frustum, spheres, reference.data(), CULL_SCALAR);
+	std::cout << "[culling] best path on this CPU: " << cullPathName(bestCullPath()) << std::endl;
+	for (CullPath path : { CULL_SCALAR, CULL_SSE, CULL_AVX }) {
+		size_t count = 0;
+		auto start = BenchClock::now();
+		for (int i = 0; i < rounds; i++)
+			count = cullSpheres(frustum, spheres, visible.data(), path);
+		double ms = msSince(start) / rounds;
+		bool same = count == expected && std::equal(reference.begin(), reference.begin() + count, visible.begin());
+		std::cout << "[culling] " << cullPathName(path) << ": " << spheres.count << " spheres in " << ms << " ms, "
+			<< spheres.count / ms << " objects/ms, " << count << " visible" << (same ? "" : " (MISMATCH)") << std::endl;
+	}
+
+	scene.setBoxInstances(boxes);
+	for (int pass = 0; pass < 2; pass++) {
+		scene.setCulling(pass == 1);
+		scene.render(cam);
+		glFinish();
+		double cullMs = 0.0;
+		size_t visibleBoxes = 0;
+		auto start = BenchClock::now();
+		for (int i = 0; i < frames; i++) {
+			scriptCamera(cam, i);
+			scene.render(cam);
+			glFinish();
+			cullMs += scene.getCullStats().cullMs;
+			visibleBoxes += scene.getCullStats().visibleBoxes;
+		}
+		std::cout << "[culling] " << boxes.size() << " boxes, culling " << (pass == 1 ? "on" : "off") << ": "
+			<< msSince(start) / frames << " ms/frame, " << visibleBoxes / frames << " drawn, cull + upload "
+			<< cullMs / frames << " ms" << std::endl;
+	}
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+// build, frustum query, ray pick and refit from 10k objects up, at the density of
+// the culling stress scene so about the same number stays inside the frustum
+static void benchBvh(Scene &scene, const BenchOptions &options) {
+	const int rays = 10000;
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	glm::mat4 view = cam.getViewMat();
+	glm::mat4 project = glm::perspective(glm::radians(cam.getFovY()), (float)BENCH_WIDTH / BENCH_HEIGHT, 0.1f, 100.0f);
+	Frustum frustum = extractFrustum(project * view);
+	unsigned int seed = 24680u;
+	auto next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (float)(seed >> 8) / 16777216.0f;
+	};
+	for (int count = 10000; count <= options.maxObjects; count *= 10) {
+		float extent = 100.0f * (float)std::cbrt(count / 1.0e6);
+		std::vector<Aabb> bounds(count);
+		BoundingSpheres spheres;
+		spheres.resize(count);
+		for (int i = 0; i < count; i++) {
+			glm::vec3 center = glm::vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f) * 2.0f * extent;
+			glm::vec3 half = glm::vec3(next(), next(), next()) * 0.5f + 0.125f;
+			bounds[i].min = center - half;
+			bounds[i].max = center + half;
+			spheres.set(i, center, glm::length(half));
+		}
+		std::vector<unsigned int> visible(spheres.x.size());
+
+		Bvh bvh;
+		auto start = BenchClock::now();
+		bvh.build(bounds.data(), bounds.size());
+		double buildMs = msSince(start);
+
+		const int rounds = 10;
+		size_t found = 0, flatFound = 0;
+		start = BenchClock::now();
+		for (int i = 0; i < rounds; i++)
+			found = bvh.queryFrustum(frustum, visible.data());
+		double queryMs = msSince(start) / rounds;
+		start = BenchClock::now();
+		for (int i = 0; i < rounds; i++)
+			flatFound = cullSpheres(frustum, spheres, visible.data());
+		double flatMs = msSince(start) / rounds;
+
+		int hits = 0;
+		start = BenchClock::now();
+		for (int i = 0; i < rays; i++) {
+			BvhHit hit;
+			hits += bvh.raycast(screenRay(view, project, next() * 2.0f - 1.0f, next() * 2.0f - 1.0f), hit);
+		}
+		double rayUs = msSince(start) * 1000.0 / rays;
+
+		// everything drifts a little, as animated objects would between frames
+		for (Aabb &box : bounds) {
+			glm::vec3 offset = glm::vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f);
+			box.min += offset;
+			box.max += offset;
+		}
+		float builtCost = bvh.getCost();
+		start = BenchClock::now();
+		float refitCost = bvh.refit(bounds.data());
+		double refitMs = msSince(start);
+
+		std::cout << "[bvh] " << count << " objects: build " << buildMs << " ms (" << bvh.getNodeCount() << " nodes, depth "
+			<< bvh.getDepth() << ", cost " << builtCost << "), frustum " << queryMs << " ms for " << found
+			<< " (flat " << cullPathName(bestCullPath()) << " " << flatMs << " ms for " << flatFound << "), ray "
+			<< rayUs << " us (" << hits << "/" << rays << " hit), refit " << refitMs << " ms (cost " << refitCost << ")" << std::endl;
+	}
+
+	// picking through the scene, straight ahead from the default camera
+	BvhHit hit;
+	if (scene.pickBox(cam, 0.0f, 0.0f, hit))
+		std::cout << "[bvh] pick at screen center: box " << hit.index << " at " << hit.distance << std::endl;
+	else
+		std::cout << "[bvh] pick at screen center: nothing" << std::endl;
+}
+
+// the same frames with and without timing, plus what the profiler itself reports
+static void benchProfiler(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 100 ? options.frames : 100;
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	Profiler profiler(frames);
+	double plainMs = 0.0, profiledMs = 0.0;
+	size_t allocations = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		scene.setProfiler(pass == 1 ? &profiler : nullptr);
+		// the first profiled frames create the query objects
+		for (int i = 0; i < PROFILER_QUERY_FRAMES + 1; i++) {
+			if (pass == 1)
+				profiler.beginFrame();
+			scene.render(cam);
+			if (pass == 1)
+				profiler.endFrame();
+		}
+		glFinish();
+		size_t before = heapAllocations;
+		auto start = BenchClock::now();
+		for (int i = 0; i < frames; i++) {
+			if (pass == 1)
+				profiler.beginFrame();
+			scene.render(cam);
+			glFinish();
+			if (pass == 1)
+				profiler.endFrame();
+		}
+		(pass == 1 ? profiledMs : plainMs) = msSince(start) / frames;
+		if (pass == 1)
+			allocations = heapAllocations - before;
+	}
+	scene.setProfiler(nullptr);
+	std::cout << "[profiler] " << plainMs << " ms/frame plain, " << profiledMs << " ms/frame profiled, "
+		<< allocations << " allocations over " << frames << " profiled frames" << std::endl;
+	profiler.printSummary(std::cout);
+}
+
+// CPU culling with compacted instance uploads against culling and drawing on the
+// GPU; render() returns before the GPU is done, so its time is the CPU cost
+static void benchIndirect(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 20 ? options.frames : 20;
+	if (!IndirectDraws::isSupported()) {
+		std::cout << "[indirect] needs GL 4.3, skipped" << std::endl;
+		return;
+	}
+	std::cout << "[indirect] draw count " << (GLExt::hasIndirectParameters ? "from the GPU (ARB_indirect_parameters)"
+		: "fixed, hidden objects draw no instances") << std::endl;
+	std::vector<unsigned char> pixels[2];
+	for (int count = 10000; count <= options.maxInstances; count *= 10) {
+		scene.setBoxInstances(scatteredBoxes(count, 100.0f * (float)std::cbrt(count / 1.0e6)));
+		for (int pass = 0; pass < 2; pass++) {
+			Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+			if (!scene.setGpuDriven(pass == 1))
+				return;
+			scene.render(cam);
+			glFinish();
+			double cpuMs = 0.0;
+			auto start = BenchClock::now();
+			for (int i = 0; i < frames; i++) {
+				scriptCamera(cam, i);
+				auto renderStart = BenchClock::now();
+				scene.render(cam);
+				cpuMs += msSince(renderStart);
+				glFinish();
+			}
+			double ms = msSince(start) / frames;
+			size_t drawn = pass == 1 ? scene.readGpuVisibleBoxes() : scene.getCullStats().visibleBoxes;
+			pixels[pass].resize((size_t)BENCH_WIDTH * BENCH_HEIGHT * 4);
+			glReadPixels(0, 0, BENCH_WIDTH, BENCH_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels[pass].data());
+			std::cout << "[indirect] " << count << " boxes, " << (pass == 1 ? "GPU driven" : "CPU culled") << ": "
+				<< ms << " ms/frame, render() " << cpuMs / frames << " ms on the CPU, " << drawn << " drawn";
+			if (pass == 1) {
+				size_t differing = 0;
+				for (size_t i = 0; i < pixels[0].size(); i += 4)
+					differing += memcmp(&pixels[0][i], &pixels[1][i], 3) != 0;
+				std::cout << ", " << differing << " pixels differ";
+			}
+			std::cout << std::endl;
+		}
+	}
+	scene.setGpuDriven(false);
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+// a grid of boxes seen head on, most hidden behind the front layers: frames with
+// and without occlusion culling, which must come out pixel for pixel the same
+static void benchOcclusion(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 20 ? options.frames : 20;
+	std::vector<unsigned char> pixels[2];
+	for (int count = 1000; count <= 100000 && count <= options.maxInstances; count *= 10) {
+		scene.setBoxInstances(cubeGrid(count));
+		for (int pass = 0; pass < 2; pass++) {
+			Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+			scene.setOcclusionCulling(pass == 1);
+			scene.render(cam);
+			glFinish();
+			size_t drawn = 0, hidden = 0, occluders = 0;
+			double occlusionMs = 0.0;
+			auto start = BenchClock::now();
+			for (int i = 0; i < frames; i++) {
+				scriptCamera(cam, i);
+				scene.render(cam);
+				glFinish();
+				const Scene::CullStats &stats = scene.getCullStats();
+				drawn += stats.visibleBoxes;
+				hidden += stats.occludedBoxes;
+				occluders += stats.occluders;
+				occlusionMs += stats.occlusionMs;
+			}
+			double ms = msSince(start) / frames;
+			pixels[pass].resize((size_t)BENCH_WIDTH * BENCH_HEIGHT * 4);
+			glReadPixels(0, 0, BENCH_WIDTH, BENCH_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels[pass].data());
+			std::cout << "[occlusion] " << count << " boxes, occlusion " << (pass == 1 ? "on" : "off") << ": "
+				<< ms << " ms/frame, " << drawn / frames << " drawn";
+			if (pass == 1) {
+				size_t differing = 0;
+				for (size_t i = 0; i < pixels[0].size(); i += 4)
+					differing += memcmp(&pixels[0][i], &pixels[1][i], 3) != 0;
+				std::cout << ", " << hidden / frames << " hidden (" << 100.0 * hidden / (drawn + hidden) << "%) by "
+					<< occluders / frames << " occluders in " << occlusionMs / frames << " ms, "
+					<< differing << " pixels differ";
+			}
+			std::cout << std::endl;
+		}
+	}
+	scene.setOcclusionCulling(false);
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+// the CPU renderer on the scene and on growing box grids, next to the GL frame time
+static void benchSoftware(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 10 ? options.frames : 10;
+	Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+	SoftwareRenderer software(BENCH_WIDTH, BENCH_HEIGHT, scene.getThreadPool());
+	for (int count = 0; count <= 10000 && count <= options.maxInstances; count = count ? count * 10 : 100) {
+		std::vector<glm::mat4> boxes = count ? cubeGrid(count) : Scene::defaultBoxInstances();
+		scene.setBoxInstances(boxes);
+		software.setBoxInstances(boxes);
+		scene.render(cam);
+		glFinish();
+		software.render(cam);
+
+		auto start = BenchClock::now();
+		for (int i = 0; i < frames; i++) {
+			scene.render(cam);
+			glFinish();
+		}
+		double glMs = msSince(start) / frames;
+		start = BenchClock::now();
+		for (int i = 0; i < frames; i++)
+			software.render(cam);
+		double softMs = msSince(start) / frames;
+
+		const SoftwareRenderer::Stats &stats = software.getStats();
+		std::cout << "[software] " << stats.instances << " instances: " << softMs << " ms/frame (setup "
+			<< stats.setupMs << " ms, raster " << stats.rasterMs << " ms), " << stats.triangles << " triangles, "
+			<< stats.culled << " culled, " << stats.shadedPixels << " pixels shaded; GL " << glMs << " ms/frame" << std::endl;
+	}
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+// culled frames submitted back to back with no glFinish between them: the
+// instances and uniform blocks stream through the ring, which only waits when
+// the GPU falls STREAM_FRAMES frames behind
+static void benchStream(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 30 ? options.frames : 30;
+	const StreamBuffer &stream = scene.getStreamBuffer();
+	std::cout << "[stream] " << (stream.isPersistent() ? "persistent coherent mapping (ARB_buffer_storage)"
+		: "unsynchronized map per allocation") << ", " << STREAM_FRAMES << " regions" << std::endl;
+	bool culling = scene.getCulling();
+	scene.setCulling(true);
+	for (int count = 10000; count <= options.maxInstances; count *= 10) {
+		scene.setBoxInstances(scatteredBoxes(count, 100.0f * (float)std::cbrt(count / 1.0e6)));
+		Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+		scene.render(cam);
+		glFinish();
+		StreamBuffer::Stats before = stream.getStats();
+		double cpuMs = 0.0;
+		size_t bytes = 0;
+		auto start = BenchClock::now();
+		for (int i = 0; i < frames; i++) {
+			scriptCamera(cam, i);
+			auto renderStart = BenchClock::now();
+			scene.render(cam);
+			cpuMs += msSince(renderStart);
+			bytes += stream.getStats().frameBytes;
+		}
+		glFinish();
+		double ms = msSince(start) / frames;
+		const StreamBuffer::Stats &stats = stream.getStats();
+		std::cout << "[stream] " << count << " boxes: " << ms << " ms/frame, render() " << cpuMs / frames
+			<< " ms on the CPU, " << bytes / frames / 1024 << " KB/frame streamed into " << stats.regionBytes / 1024
+			<< " KB regions, " << stats.waits - before.waits << " waits (" << stats.waitMs - before.waitMs << " ms), "
+			<< stats.grows - before.grows << " grows" << std::endl;
+	}
+	scene.setCulling(culling);
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+// the radix sort of the render queue against std::stable_sort on random keys,
+// then the cube grid handed over back to front, drawn in that order and
+// nearest first; sorting must not change a pixel
+static void benchQueue(Scene &scene, const BenchOptions &options) {
+	const int frames = options.frames < 20 ? options.frames : 20;
+	unsigned long long seed = 99991ull;
+	for (int count = 1000; count <= 1000000 && count <= options.maxObjects; count *= 10) {
+		std::vector<RenderQueue::SortEntry> keys(count), radix, reference, scratch(count);
+		for (int i = 0; i < count; i++) {
+			seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+			keys[i] = { seed, (unsigned int)i };
+		}
+		radix = reference = keys;
+		auto start = BenchClock::now();
+		RenderQueue::radixSort(radix.data(), scratch.data(), radix.size());
+		double radixMs = msSince(start);
+		start = BenchClock::now();
+		std::stable_sort(reference.begin(), reference.end(),
+			[](const RenderQueue::SortEntry &a, const RenderQueue::SortEntry &b) { return a.key < b.key; });
+		double stdMs = msSince(start);
+		bool same = true;
+		for (int i = 0; i < count; i++)
+			same = same && radix[i].key == reference[i].key && radix[i].index == reference[i].index;
+		std::cout << "[queue] " << count << " keys: radix sort " << radixMs << " ms, std::stable_sort " << stdMs
+			<< " ms" << (same ? "" : " (MISMATCH)") << std::endl;
+	}
+
+	std::vector<unsigned char> pixels[2];
+	for (int count = 1000; count <= 100000 && count <= options.maxInstances; count *= 10) {
+		std::vector<glm::mat4> boxes = cubeGrid(count);
+		std::reverse(boxes.begin(), boxes.end());
+		scene.setBoxInstances(boxes);
+		for (int pass = 0; pass < 2; pass++) {
+			Camera cam(glm::vec3(0.0f, 0.0f, -3.0f));
+			scene.setDepthSort(pass == 1);
+			scene.render(cam);
+			glFinish();
+			GLState::resetStats();
+			unsigned int programs = 0, materials = 0, vaos = 0;
+			size_t items = 0;
+			double sortMs = 0.0;
+			auto start = BenchClock::now();
+			for (int i = 0; i < frames; i++) {
+				scene.render(cam);
+				glFinish();
+				const RenderQueue::Stats &stats = scene.getRenderQueue().getStats();
+				items += stats.items;
+				programs += stats.programChanges;
+				materials += stats.materialChanges;
+				vaos += stats.vaoChanges;
+				sortMs += stats.sortMs;
+			}
+			double ms = msSince(start) / frames;
+			pixels[pass].resize((size_t)BENCH_WIDTH * BENCH_HEIGHT * 4);
+			glReadPixels(0, 0, BENCH_WIDTH, BENCH_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels[pass].data());
+			std::cout << "[queue] " << count << " boxes back to front, " << (pass == 1 ? "depth sorted" : "as given")
+				<< ": " << ms << " ms/frame, " << scene.getCullStats().visibleBoxes << " drawn; per frame "
+				<< items / frames << " draws, " << programs / frames << " program, " << materials / frames
+				<< " material, " << vaos / frames << " vao changes, queue sort " << sortMs / frames << " ms; GL "
+				<< GLState::stats.programs.issued / frames << " program, " << GLState::stats.textures.issued / frames
+				<< " texture, " << GLState::stats.vertexArrays.issued / frames << " vao binds";
+			if (pass == 1) {
+				size_t differing = 0;
+				for (size_t i = 0; i < pixels[0].size(); i += 4)
+					differing += memcmp(&pixels[0][i], &pixels[1][i], 3) != 0;
+				std::cout << ", " << differing << " pixels differ";
+			}
+			std::cout << std::endl;
+		}
+	}
+	scene.setDepthSort(true);
+	scene.setBoxInstances(Scene::defaultBoxInstances());
+}
+
+struct Benchmark {
+	const char* name;
+	void (*run)(Scene &scene, const BenchOptions &options);
+};
+
+static const Benchmark benchmarks[] = {
+	{ "uniforms", benchUniforms },
+	{ "frames", benchFrames },
+	{ "instances", benchInstances },
+	{ "normals", benchNormals },
+	{ "mesh", benchMesh },
+	{ "lights", benchLights },
+	{ "textures", benchTextures },
+	{ "state", benchState },
+	{ "allocations", benchAllocations },
+	{ "programs", benchPrograms },
+	{ "batch", benchBatch },
+	{ "features", benchFeatures },
+	{ "profiler", benchProfiler },
+	{ "culling", benchCulling },
+	{ "bvh", benchBvh },
+	{ "occlusion", benchOcclusion },
+	{ "indirect", benchIndirect },
+	{ "software", benchSoftware },
+	{ "stream", benchStream },
+	{ "arena", benchArena },
+	{ "queue", benchQueue },
+};
+
+// learnopengl_bench [--window] [--frames n] [--warmup n] [--max-instances n] [--max-objects n]
+//                   [--record file] [--replay file] [benchmark ...]
+// with no benchmark names every benchmark runs
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	std::vector<const Benchmark*> selected;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--window") == 0) {
+			options.backend = BACKEND_WINDOW;
+			continue;
+		}
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			options.frames = atoi(argv[++i]);
+			continue;
+		}
+		if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			options.warmup = atoi(argv[++i]);
+			continue;
+		}
+		if (strcmp(argv[i], "--max-instances") == 0 && i + 1 < argc) {
+			options.maxInstances = atoi(argv[++i]);
+			continue;
+		}
+		if (strcmp(argv[i], "--max-objects") == 0 && i + 1 < argc) {
+			options.maxObjects = atoi(argv[++i]);
+			continue;
+		}
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			options.recordPath = argv[++i];
+			continue;
+		}
+		if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			options.replayPath = argv[++i];
+			continue;
+		}
+		const Benchmark* found = nullptr;
+		for (const Benchmark &b : benchmarks)
+			if (strcmp(argv[i], b.name) == 0)
+				found = &b;
+		if (!found) {
+			std::cout << "Unknown benchmark: " << argv[i] << std::endl;
+			return -1;
+		}
+		selected.push_back(found);
+	}
+	if (selected.empty())
+		for (const Benchmark &b : benchmarks)
+			selected.push_back(&b);
+
+	RenderContext context;
+	if (!context.init(options.backend, BENCH_WIDTH, BENCH_HEIGHT))
+		return -1;
+	GLState::enable(GL_DEPTH_TEST);
+	std::cout << "renderer: " << glGetString(GL_RENDERER) << " | " << glGetString(GL_VERSION) << std::endl;
+
+	{
+		Scene scene(BENCH_WIDTH, BENCH_HEIGHT);
+		scene.finishLoading();
+		for (const Benchmark* b : selected)
+			b->run(scene, options);
+	}
+	context.terminate();
+	return 0;
+}
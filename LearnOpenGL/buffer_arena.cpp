@@ -0,0 +1,236 @@
+#include "buffer_arena.h"
+
+#include <algorithm>
+
+static size_t alignUp(size_t bytes, size_t alignment)
+{
+	return (bytes + alignment - 1) / alignment * alignment;
+}
+
+BufferArena::BufferArena(size_t capacity, size_t alignment)
+	: buffer_(0),
+	  alignment_(alignment ? alignment : 1),
+	  stats_()
+{
+	stats_.capacity = alignUp(capacity ? capacity : alignment_, alignment_);
+	glGenBuffers(1, &buffer_);
+	// a target nothing else binds, so no vao or element binding is disturbed
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)stats_.capacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	free_.push_back({ 0, stats_.capacity });
+	updateFreeStats();
+}
+
+BufferArena::~BufferArena()
+{
+	glDeleteBuffers(1, &buffer_);
+}
+
+ArenaHandle BufferArena::allocate(size_t bytes)
+{
+	size_t size = alignUp(bytes ? bytes : 1, alignment_);
+	size_t best = free_.size();
+	for (size_t i = 0; i < free_.size(); i++)
+	{
+		if (free_[i].size >= size && (best == free_.size() || free_[i].size < free_[best].size))
+			best = i;
+	}
+	if (best == free_.size())
+	{
+		// the free bytes are there but scattered, or there are too few
+		if (stats_.capacity - stats_.used >= size)
+			defragment();
+		else
+			resize(alignUp(std::max(stats_.capacity * 2, stats_.capacity + size), alignment_));
+		// either way the last block is free and large enough now
+		best = free_.size() - 1;
+	}
+
+	ArenaHandle handle;
+	if (!releasedHandles_.empty())
+	{
+		handle = releasedHandles_.back();
+		releasedHandles_.pop_back();
+	}
+	else
+	{
+		handle = (ArenaHandle)allocations_.size();
+		allocations_.push_back({ 0, 0 });
+	}
+	allocations_[handle] = { takeFree(best, size), size };
+	stats_.used += size;
+	stats_.allocations++;
+	updateFreeStats();
+	return handle;
+}
+
+void BufferArena::free(ArenaHandle handle)
+{
+	if (handle == ARENA_INVALID_HANDLE || handle >= allocations_.size() || allocations_[handle].size == 0)
+		return;
+	Block& block = allocations_[handle];
+	addFree(block.offset, block.size);
+	stats_.used -= block.size;
+	stats_.allocations--;
+	block.size = 0;
+	releasedHandles_.push_back(handle);
+	updateFreeStats();
+}
+
+void BufferArena::upload(ArenaHandle handle, const void* data, size_t bytes)
+{
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocations_[handle].offset,
+		(GLsizeiptr)std::min(bytes, allocations_[handle].size), data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+size_t BufferArena::takeFree(size_t i, size_t bytes)
+{
+	size_t offset = free_[i].offset;
+	if (free_[i].size == bytes)
+	{
+		free_.erase(free_.begin() + i);
+	}
+	else
+	{
+		free_[i].offset += bytes;
+		free_[i].size -= bytes;
+	}
+	return offset;
+}
+
+void BufferArena::addFree(size_t offset, size_t size)
+{
+	auto next = std::lower_bound(free_.begin(), free_.end(), offset,
+		[](const Block& block, size_t value) { return block.offset < value; });
+	size_t i = next - free_.begin();
+	bool mergePrevious = i > 0 && free_[i - 1].offset + free_[i - 1].size == offset;
+	bool mergeNext = i < free_.size() && offset + size == free_[i].offset;
+	if (mergePrevious && mergeNext)
+	{
+		free_[i - 1].size += size + free_[i].size;
+		free_.erase(free_.begin() + i);
+	}
+	else if (mergePrevious)
+	{
+		free_[i - 1].size += size;
+	}
+	else if (mergeNext)
+	{
+		free_[i].offset = offset;
+		free_[i].size += size;
+	}
+	else
+	{
+		free_.insert(free_.begin() + i, { offset, size });
+	}
+}
+
+void BufferArena::defragment()
+{
+	std::vector<ArenaHandle> live;
+	live.reserve(stats_.allocations);
+	for (ArenaHandle handle = 0; handle < allocations_.size(); handle++)
+	{
+		if (allocations_[handle].size)
+			live.push_back(handle);
+	}
+	std::sort(live.begin(), live.end(), [this](ArenaHandle a, ArenaHandle b) {
+		return allocations_[a].offset < allocations_[b].offset;
+	});
+
+	// the allocations already packed at the front stay where they are
+	size_t packed = 0, first = 0;
+	while (first < live.size() && allocations_[live[first]].offset == packed)
+		packed += allocations_[live[first++]].size;
+
+	// a range may not be copied onto itself, so the rest goes through a
+	// scratch buffer: gathered there, then written back in one copy
+	size_t moved = stats_.used - packed;
+	if (moved)
+	{
+		GLuint scratch;
+		glGenBuffers(1, &scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)moved, nullptr, GL_STREAM_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+		size_t target = 0;
+		for (size_t i = first; i < live.size(); i++)
+		{
+			Block& block = allocations_[live[i]];
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)block.offset, (GLintptr)target, (GLsizeiptr)block.size);
+			block.offset = packed + target;
+			target += block.size;
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)packed, (GLsizeiptr)moved);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &scratch);
+	}
+
+	free_.clear();
+	if (stats_.capacity > stats_.used)
+		free_.push_back({ stats_.used, stats_.capacity - stats_.used });
+	stats_.defrags++;
+	stats_.bytesMoved += moved;
+	updateFreeStats();
+}
+
+void BufferArena::resize(size_t capacity)
+{
+	// everything past the last allocation is free and need not be kept
+	size_t end = stats_.capacity;
+	if (!free_.empty() && free_.back().offset + free_.back().size == stats_.capacity)
+		end = free_.back().offset;
+
+	// glBufferData on the same name keeps it valid in every vao, but drops the
+	// contents, so they wait in a scratch buffer meanwhile
+	GLuint scratch = 0;
+	if (end)
+	{
+		glGenBuffers(1, &scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)end, nullptr, GL_STREAM_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)end);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity, nullptr, GL_STATIC_DRAW);
+	if (end)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)end);
+		glDeleteBuffers(1, &scratch);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	addFree(stats_.capacity, capacity - stats_.capacity);
+	stats_.capacity = capacity;
+	stats_.grows++;
+	stats_.bytesMoved += end;
+	updateFreeStats();
+}
+
+void BufferArena::updateFreeStats()
+{
+	stats_.freeBlocks = free_.size();
+	stats_.largestFree = 0;
+	for (const Block& block : free_)
+		stats_.largestFree = std::max(stats_.largestFree, block.size);
+}
+
+float BufferArena::getUtilization() const
+{
+	return stats_.capacity ? (float)stats_.used / (float)stats_.capacity : 0.0f;
+}
+
+float BufferArena::getFragmentation() const
+{
+	size_t freeBytes = stats_.capacity - stats_.used;
+	return freeBytes ? 1.0f - (float)stats_.largestFree / (float)freeBytes : 0.0f;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+// handle of a BufferArena allocation, it survives defragment() and growth
+typedef unsigned int ArenaHandle;
+#define ARENA_INVALID_HANDLE 0xFFFFFFFFu
+
+// Sub-allocates ranges of one large GL buffer, so many small objects share it.
+// Free space is a list of blocks sorted by offset; allocate() takes the
+// smallest block that fits and free() merges the range with free neighbours.
+// When no single block fits, the arena defragments if the free bytes suffice
+// and grows otherwise. Both copy the data on the GPU with glCopyBufferSubData
+// and keep the buffer name, so vaos and bindings stay valid; only the offsets
+// change, which is why callers keep handles and look offsets up when drawing.
+// Sizes are rounded up to the alignment, so every offset is a multiple of it.
+// Requires a current GL context for its whole lifetime.
+class BufferArena
+{
+public:
+	struct Stats
+	{
+		size_t capacity;
+		// allocated bytes, rounded to the alignment
+		size_t used;
+		size_t allocations;
+		size_t freeBlocks;
+		size_t largestFree;
+		unsigned int defrags;
+		unsigned int grows;
+		// copied by defrags and grows together
+		size_t bytesMoved;
+	};
+
+	BufferArena(size_t capacity, size_t alignment);
+	~BufferArena();
+
+	BufferArena(const BufferArena&) = delete;
+	BufferArena& operator=(const BufferArena&) = delete;
+
+	ArenaHandle allocate(size_t bytes);
+	void free(ArenaHandle handle);
+	// write bytes at the start of the allocation
+	void upload(ArenaHandle handle, const void* data, size_t bytes);
+	// pack every allocation to the front, leaving one free block at the end
+	void defragment();
+
+	GLuint getBuffer() const { return buffer_; }
+	size_t getAlignment() const { return alignment_; }
+	size_t getOffset(ArenaHandle handle) const { return allocations_[handle].offset; }
+	size_t getSize(ArenaHandle handle) const { return allocations_[handle].size; }
+	const Stats& getStats() const { return stats_; }
+	// used / capacity
+	float getUtilization() const;
+	// share of the free bytes outside the largest free block, 0 when it is all one block
+	float getFragmentation() const;
+
+private:
+	struct Block
+	{
+		size_t offset;
+		size_t size;
+	};
+
+	// take bytes from free block i, which must fit them
+	size_t takeFree(size_t i, size_t bytes);
+	void addFree(size_t offset, size_t size);
+	void resize(size_t capacity);
+	void updateFreeStats();
+
+	GLuint buffer_;
+	size_t alignment_;
+	// indexed by handle, size 0 marks a released slot
+	std::vector<Block> allocations_;
+	std::vector<ArenaHandle> releasedHandles_;
+	// sorted by offset, no two adjacent
+	std::vector<Block> free_;
+	Stats stats_;
+};
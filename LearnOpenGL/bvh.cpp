@@ -0,0 +1,356 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+
+static const Aabb EMPTY_AABB = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+
+static inline void grow(Aabb& box, const glm::vec3& min, const glm::vec3& max)
+{
+	box.min = glm::min(box.min, min);
+	box.max = glm::max(box.max, max);
+}
+
+static inline float halfArea(const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 e = glm::max(max - min, glm::vec3(0.0f));
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// entry distance of the ray into the box, clamped to the origin
+static inline bool intersectRay(const glm::vec3& min, const glm::vec3& max, const Ray& ray,
+	const glm::vec3& invDirection, float maxDistance, float& entry)
+{
+	glm::vec3 t0 = (min - ray.origin) * invDirection;
+	glm::vec3 t1 = (max - ray.origin) * invDirection;
+	glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+	entry = enter;
+	return enter <= exit && enter < maxDistance;
+}
+
+// -1 outside a plane, 1 inside all, 0 crossing; planes fully containing the box leave mask
+static inline int classify(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max, unsigned int& mask)
+{
+	for (int k = 0; k < 6; k++)
+	{
+		if (!(mask & (1u << k)))
+			continue;
+		const glm::vec4& p = frustum.planes[k];
+		glm::vec3 n(p);
+		// the corners furthest along and against the plane normal
+		glm::vec3 positive(n.x >= 0.0f ? max.x : min.x, n.y >= 0.0f ? max.y : min.y, n.z >= 0.0f ? max.z : min.z);
+		glm::vec3 negative(n.x >= 0.0f ? min.x : max.x, n.y >= 0.0f ? min.y : max.y, n.z >= 0.0f ? min.z : max.z);
+		if (glm::dot(n, positive) + p.w < 0.0f)
+			return -1;
+		if (glm::dot(n, negative) + p.w >= 0.0f)
+			mask &= ~(1u << k);
+	}
+	return mask == 0 ? 1 : 0;
+}
+
+Aabb transformedCubeBounds(const glm::mat4& model)
+{
+	glm::vec3 center(model[3]);
+	glm::vec3 extent = (glm::abs(glm::vec3(model[0])) + glm::abs(glm::vec3(model[1])) + glm::abs(glm::vec3(model[2]))) * 0.5f;
+	Aabb box = { center - extent, center + extent };
+	return box;
+}
+
+Ray screenRay(const glm::mat4& view, const glm::mat4& project, float ndcX, float ndcY)
+{
+	glm::mat4 inverse = glm::inverse(project * view);
+	glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+	Ray ray;
+	ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+	ray.direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - ray.origin);
+	return ray;
+}
+
+void Bvh::clear()
+{
+	nodes_.clear();
+	indices_.clear();
+	bounds_.clear();
+	depth_ = 0;
+	cost_ = 0.0f;
+}
+
+// the build partitions these in place, so every pass over a node's objects reads memory in order
+struct Bvh::BuildItem
+{
+	Aabb bounds;
+	glm::vec3 centroid;
+	unsigned int index;
+};
+
+void Bvh::build(const Aabb* bounds, size_t count)
+{
+	clear();
+	bounds_.assign(bounds, bounds + count);
+	nodes_.reserve(count);
+	std::vector<BuildItem> items(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		items[i].bounds = bounds[i];
+		items[i].centroid = (bounds[i].min + bounds[i].max) * 0.5f;
+		items[i].index = (unsigned int)i;
+	}
+	if (count > 0)
+		buildNode(0, count, 1, items);
+	indices_.resize(count);
+	for (size_t i = 0; i < count; i++)
+		indices_[i] = items[i].index;
+	cost_ = computeCost();
+}
+
+unsigned int Bvh::buildNode(size_t first, size_t count, int depth, std::vector<BuildItem>& items)
+{
+	depth_ = std::max(depth_, depth);
+	unsigned int index = (unsigned int)nodes_.size();
+	nodes_.push_back(Node());
+
+	Aabb box = EMPTY_AABB, centroidBox = EMPTY_AABB;
+	for (size_t i = first; i < first + count; i++)
+	{
+		grow(box, items[i].bounds.min, items[i].bounds.max);
+		grow(centroidBox, items[i].centroid, items[i].centroid);
+	}
+	nodes_[index].min = box.min;
+	nodes_[index].max = box.max;
+
+	size_t leftCount = 0;
+	bool leaf = count == 1;
+	if (!leaf && depth < BVH_MEDIAN_DEPTH)
+	{
+		// one pass bins every axis
+		Aabb bins[3][BVH_BINS];
+		size_t binCounts[3][BVH_BINS] = {};
+		std::fill(&bins[0][0], &bins[0][0] + 3 * BVH_BINS, EMPTY_AABB);
+		glm::vec3 extent = centroidBox.max - centroidBox.min;
+		glm::vec3 scale;
+		for (int axis = 0; axis < 3; axis++)
+			scale[axis] = extent[axis] > 0.0f ? BVH_BINS / extent[axis] : 0.0f;
+		for (size_t i = first; i < first + count; i++)
+		{
+			const BuildItem& item = items[i];
+			glm::vec3 offset = (item.centroid - centroidBox.min) * scale;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				int bin = std::min(BVH_BINS - 1, (int)offset[axis]);
+				grow(bins[axis][bin], item.bounds.min, item.bounds.max);
+				binCounts[axis][bin]++;
+			}
+		}
+
+		// cost of each candidate plane: area times objects on both sides, in units of one object test
+		float bestCost = FLT_MAX;
+		int bestAxis = -1, bestBin = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (extent[axis] <= 0.0f)
+				continue;
+			float leftArea[BVH_BINS - 1];
+			size_t leftCounts[BVH_BINS - 1];
+			Aabb left = EMPTY_AABB;
+			size_t n = 0;
+			for (int b = 0; b < BVH_BINS - 1; b++)
+			{
+				grow(left, bins[axis][b].min, bins[axis][b].max);
+				n += binCounts[axis][b];
+				leftArea[b] = halfArea(left.min, left.max);
+				leftCounts[b] = n;
+			}
+			Aabb right = EMPTY_AABB;
+			n = 0;
+			for (int b = BVH_BINS - 1; b > 0; b--)
+			{
+				grow(right, bins[axis][b].min, bins[axis][b].max);
+				n += binCounts[axis][b];
+				if (n == 0 || leftCounts[b - 1] == 0)
+					continue;
+				float cost = leftArea[b - 1] * leftCounts[b - 1] + halfArea(right.min, right.max) * n;
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b - 1;
+				}
+			}
+		}
+
+		// a split pays for one more node visit, a leaf tests all its objects
+		float area = halfArea(box.min, box.max);
+		bool splitPays = bestAxis >= 0 && bestCost + area < area * count;
+		if (bestAxis >= 0 && (splitPays || count > BVH_MAX_LEAF_SIZE))
+		{
+			// the same arithmetic as the binning, so both sides keep their objects
+			auto middle = std::partition(items.begin() + first, items.begin() + first + count,
+				[&](const BuildItem& item) {
+					float offset = (item.centroid[bestAxis] - centroidBox.min[bestAxis]) * scale[bestAxis];
+					return std::min(BVH_BINS - 1, (int)offset) <= bestBin;
+				});
+			leftCount = middle - (items.begin() + first);
+		}
+		else
+			leaf = count <= BVH_MAX_LEAF_SIZE;
+	}
+	if (!leaf && (leftCount == 0 || leftCount == count))
+	{
+		if (count <= BVH_MAX_LEAF_SIZE)
+			leaf = true;
+		else
+		{
+			// deep or degenerate: halve at the object median along the widest centroid axis
+			glm::vec3 extent = centroidBox.max - centroidBox.min;
+			int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+			leftCount = count / 2;
+			std::nth_element(items.begin() + first, items.begin() + first + leftCount, items.begin() + first + count,
+				[axis](const BuildItem& a, const BuildItem& b) { return a.centroid[axis] < b.centroid[axis]; });
+		}
+	}
+	if (leaf)
+	{
+		nodes_[index].offset = (unsigned int)first;
+		nodes_[index].count = (unsigned int)count;
+		return index;
+	}
+
+	buildNode(first, leftCount, depth + 1, items);
+	unsigned int right = buildNode(first + leftCount, count - leftCount, depth + 1, items);
+	nodes_[index].offset = right;
+	nodes_[index].count = 0;
+	return index;
+}
+
+float Bvh::refit(const Aabb* bounds)
+{
+	std::copy(bounds, bounds + bounds_.size(), bounds_.begin());
+	// children always come after their parent
+	for (size_t i = nodes_.size(); i-- > 0;)
+	{
+		Node& node = nodes_[i];
+		Aabb box = EMPTY_AABB;
+		if (node.count)
+		{
+			for (unsigned int j = node.offset; j < node.offset + node.count; j++)
+				grow(box, bounds_[indices_[j]].min, bounds_[indices_[j]].max);
+		}
+		else
+		{
+			grow(box, nodes_[i + 1].min, nodes_[i + 1].max);
+			grow(box, nodes_[node.offset].min, nodes_[node.offset].max);
+		}
+		node.min = box.min;
+		node.max = box.max;
+	}
+	cost_ = computeCost();
+	return cost_;
+}
+
+float Bvh::computeCost() const
+{
+	if (nodes_.empty())
+		return 0.0f;
+	float rootArea = halfArea(nodes_[0].min, nodes_[0].max);
+	if (rootArea <= 0.0f)
+		return 1.0f;
+	double cost = 0.0;
+	for (const Node& node : nodes_)
+		cost += halfArea(node.min, node.max) * (node.count ? node.count : 1);
+	return (float)(cost / rootArea / bounds_.size());
+}
+
+size_t Bvh::queryFrustum(const Frustum& frustum, unsigned int* visible) const
+{
+	if (nodes_.empty())
+		return 0;
+	struct Entry
+	{
+		unsigned int node;
+		unsigned int planes;
+	};
+	Entry stack[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = { 0, 0x3Fu };
+	size_t n = 0;
+	while (top > 0)
+	{
+		Entry entry = stack[--top];
+		const Node& node = nodes_[entry.node];
+		unsigned int planes = entry.planes;
+		if (planes && classify(frustum, node.min, node.max, planes) < 0)
+			continue;
+		if (node.count)
+		{
+			for (unsigned int j = node.offset; j < node.offset + node.count; j++)
+			{
+				unsigned int object = indices_[j];
+				unsigned int objectPlanes = planes;
+				visible[n] = object;
+				n += !planes || classify(frustum, bounds_[object].min, bounds_[object].max, objectPlanes) >= 0;
+			}
+			continue;
+		}
+		stack[top++] = { node.offset, planes };
+		stack[top++] = { entry.node + 1, planes };
+	}
+	return n;
+}
+
+bool Bvh::raycast(const Ray& ray, BvhHit& hit, const RayObjectTest& test) const
+{
+	hit.distance = FLT_MAX;
+	if (nodes_.empty())
+		return false;
+	glm::vec3 invDirection = glm::vec3(1.0f) / ray.direction;
+	struct Entry
+	{
+		unsigned int node;
+		float distance;
+	};
+	Entry stack[BVH_STACK_SIZE];
+	int top = 0;
+	float entry;
+	if (!intersectRay(nodes_[0].min, nodes_[0].max, ray, invDirection, hit.distance, entry))
+		return false;
+	stack[top++] = { 0, entry };
+	while (top > 0)
+	{
+		Entry current = stack[--top];
+		if (current.distance >= hit.distance)
+			continue;
+		const Node& node = nodes_[current.node];
+		if (node.count)
+		{
+			for (unsigned int j = node.offset; j < node.offset + node.count; j++)
+			{
+				unsigned int object = indices_[j];
+				if (!intersectRay(bounds_[object].min, bounds_[object].max, ray, invDirection, hit.distance, entry))
+					continue;
+				if (test)
+					entry = test(object, ray);
+				if (entry >= 0.0f && entry < hit.distance)
+				{
+					hit.index = object;
+					hit.distance = entry;
+				}
+			}
+			continue;
+		}
+		// visit the nearer child first, it is pushed last
+		unsigned int children[2] = { current.node + 1, node.offset };
+		float entries[2];
+		bool hits[2];
+		for (int c = 0; c < 2; c++)
+			hits[c] = intersectRay(nodes_[children[c]].min, nodes_[children[c]].max, ray, invDirection, hit.distance, entries[c]);
+		int nearer = hits[1] && (!hits[0] || entries[1] < entries[0]) ? 1 : 0;
+		if (hits[1 - nearer])
+			stack[top++] = { children[1 - nearer], entries[1 - nearer] };
+		if (hits[nearer])
+			stack[top++] = { children[nearer], entries[nearer] };
+	}
+	return hit.distance < FLT_MAX;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+
+// leaves hold at most this many objects
+#define BVH_MAX_LEAF_SIZE 4
+// SAH candidate planes per axis are the borders between this many bins
+#define BVH_BINS 16
+// past this depth nodes split at the object median, so no tree over 32 bit
+// indices gets deeper than BVH_MEDIAN_DEPTH + 32 and the query stacks are fixed
+#define BVH_MEDIAN_DEPTH 32
+#define BVH_STACK_SIZE (BVH_MEDIAN_DEPTH + 34)
+
+struct Aabb
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// world bounds of the -0.5..0.5 cube under model
+Aabb transformedCubeBounds(const glm::mat4& model);
+
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+};
+
+// ray through a point in normalized device coordinates, (0, 0) is the screen center
+Ray screenRay(const glm::mat4& view, const glm::mat4& project, float ndcX, float ndcY);
+
+struct BvhHit
+{
+	unsigned int index;
+	float distance;
+};
+
+// Bounding volume hierarchy over object AABBs, built top-down with a binned
+// surface area heuristic. Nodes are stored depth first in one array: the
+// left child of an interior node directly follows it, so a traversal mostly
+// walks forward through memory; a leaf names a run of the reordered object
+// indices. Moving objects can refit the existing tree instead of rebuilding.
+class Bvh
+{
+public:
+	// 32 bytes, two per cache line
+	struct Node
+	{
+		glm::vec3 min;
+		// interior: index of the right child, leaf: first entry in the object indices
+		unsigned int offset;
+		glm::vec3 max;
+		// objects in a leaf, 0 for an interior node
+		unsigned int count;
+	};
+
+	void build(const Aabb* bounds, size_t count);
+	// same objects at new positions, keeps the topology; returns getCost()
+	float refit(const Aabb* bounds);
+	void clear();
+
+	// Write the indices of the objects whose bounds touch the frustum to
+	// visible, in tree order, and return how many there are. visible needs
+	// room for every object. Subtrees fully inside are taken without testing.
+	size_t queryFrustum(const Frustum& frustum, unsigned int* visible) const;
+
+	// closest object the ray enters in front of its origin. Without a test
+	// the object AABB is the hit; test can check the object itself and return
+	// its hit distance, or a negative value for a miss.
+	typedef std::function<float(unsigned int index, const Ray& ray)> RayObjectTest;
+	bool raycast(const Ray& ray, BvhHit& hit, const RayObjectTest& test = nullptr) const;
+
+	size_t getObjectCount() const { return bounds_.size(); }
+	size_t getNodeCount() const { return nodes_.size(); }
+	int getDepth() const { return depth_; }
+	// expected traversal cost relative to testing every object, lower is better;
+	// it grows as refits stretch the tree, a hint to rebuild
+	float getCost() const { return cost_; }
+
+private:
+	struct BuildItem;
+
+	unsigned int buildNode(size_t first, size_t count, int depth, std::vector<BuildItem>& items);
+	float computeCost() const;
+
+	std::vector<Node> nodes_;
+	std::vector<unsigned int> indices_;
+	std::vector<Aabb> bounds_;
+	int depth_ = 0;
+	float cost_ = 0.0f;
+};
@@ -31,6 +31,9 @@ public:
 	glm::vec3 getCamPos();
 	glm::vec3 getCamFront();
 	float getFovY();
+	float getYaw() const { return yaw_; }
+	float getPitch() const { return pitch_; }
+	void setFovY(float fovY) { fovY_ = fovY; }
 	void translate(MoveDirection dir, float deltaTime);
 	void rotate(float offsetX, float offsetY, bool constrainPitch = true);
 	void zoom(float offsetY);
@@ -0,0 +1,154 @@
+#include "camera_path.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char PATH_MAGIC[8] = { 'L', 'O', 'G', 'L', 'C', 'A', 'M', '1' };
+
+template <typename T>
+static void writeValue(std::ofstream& file, T value)
+{
+	file.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& file, T& value)
+{
+	return (bool)file.read((char*)&value, sizeof(T));
+}
+
+bool CameraPath::save(const char* path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(PATH_MAGIC, sizeof(PATH_MAGIC));
+	writeValue(file, (unsigned int)events.size());
+	writeValue(file, startPos);
+	writeValue(file, startYaw);
+	writeValue(file, startPitch);
+	writeValue(file, startFovY);
+	for (const CameraEvent& event : events) {
+		// type in the low bits, direction above
+		writeValue(file, (unsigned char)(event.type | event.direction << 2));
+		writeValue(file, event.time);
+		writeValue(file, event.a);
+		if (event.type == CAMERA_ROTATE)
+			writeValue(file, event.b);
+	}
+	if (!file) {
+		std::cout << "ERROR::CAMERA_PATH::WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool CameraPath::load(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(PATH_MAGIC)];
+	unsigned int count = 0;
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, PATH_MAGIC, sizeof(magic)) != 0
+		|| !readValue(file, count) || !readValue(file, startPos) || !readValue(file, startYaw)
+		|| !readValue(file, startPitch) || !readValue(file, startFovY)) {
+		std::cout << "ERROR::CAMERA_PATH::NOT_A_CAMERA_PATH " << path << std::endl;
+		return false;
+	}
+	events.clear();
+	events.reserve(count);
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned char kind = 0;
+		CameraEvent event = {};
+		if (!readValue(file, kind) || !readValue(file, event.time) || !readValue(file, event.a)) {
+			std::cout << "ERROR::CAMERA_PATH::TRUNCATED " << path << " after " << i << " events" << std::endl;
+			return false;
+		}
+		event.type = (CameraEventType)(kind & 3);
+		event.direction = (MoveDirection)(kind >> 2);
+		if (event.type == CAMERA_ROTATE && !readValue(file, event.b)) {
+			std::cout << "ERROR::CAMERA_PATH::TRUNCATED " << path << " after " << i << " events" << std::endl;
+			return false;
+		}
+		events.push_back(event);
+	}
+	return true;
+}
+
+CameraRecorder::CameraRecorder(Camera& start)
+	: time_(0.0f)
+{
+	path_.startPos = start.getCamPos();
+	path_.startYaw = start.getYaw();
+	path_.startPitch = start.getPitch();
+	path_.startFovY = start.getFovY();
+}
+
+void CameraRecorder::add(CameraEventType type, MoveDirection dir, float a, float b)
+{
+	CameraEvent event;
+	event.time = time_;
+	event.type = type;
+	event.direction = dir;
+	event.a = a;
+	event.b = b;
+	path_.events.push_back(event);
+}
+
+void CameraRecorder::translate(MoveDirection dir, float deltaTime)
+{
+	add(CAMERA_TRANSLATE, dir, deltaTime, 0.0f);
+}
+
+void CameraRecorder::rotate(float offsetX, float offsetY)
+{
+	add(CAMERA_ROTATE, FORWARD, offsetX, offsetY);
+}
+
+void CameraRecorder::zoom(float offsetY)
+{
+	add(CAMERA_ZOOM, FORWARD, offsetY, 0.0f);
+}
+
+CameraPlayer::CameraPlayer(const CameraPath& path, float timestep)
+	: path_(path), timestep_(timestep > 0.0f ? timestep : 1.0f / 60.0f), next_(0), frame_(0)
+{
+}
+
+Camera CameraPlayer::start()
+{
+	next_ = 0;
+	frame_ = 0;
+	Camera cam(path_.startPos, glm::vec3(0.0f, 1.0f, 0.0f), path_.startYaw, path_.startPitch);
+	cam.setFovY(path_.startFovY);
+	return cam;
+}
+
+bool CameraPlayer::step(Camera& cam)
+{
+	if (next_ >= path_.events.size())
+		return false;
+	// frame boundaries in double so long paths do not drift
+	double end = (double)(frame_ + 1) * timestep_;
+	for (; next_ < path_.events.size() && path_.events[next_].time < end; next_++) {
+		const CameraEvent& event = path_.events[next_];
+		switch (event.type)
+		{
+		case CAMERA_TRANSLATE:
+			cam.translate(event.direction, event.a);
+			break;
+		case CAMERA_ROTATE:
+			cam.rotate(event.a, event.b);
+			break;
+		case CAMERA_ZOOM:
+			cam.zoom(event.a);
+			break;
+		}
+	}
+	frame_++;
+	return true;
+}
+
+int CameraPlayer::getFrameCount() const
+{
+	return (int)std::floor(path_.getDuration() / timestep_) + 1;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+
+enum CameraEventType
+{
+	CAMERA_TRANSLATE,
+	CAMERA_ROTATE,
+	CAMERA_ZOOM
+};
+
+// one Camera call as main's input handlers made it
+struct CameraEvent
+{
+	// seconds since recording started
+	float time;
+	CameraEventType type;
+	MoveDirection direction;
+	// translate: deltaTime, unused; rotate: offsetX, offsetY; zoom: offsetY, unused
+	float a;
+	float b;
+};
+
+// A recorded camera: the state it started in and every input applied to it.
+// The file is a small header and one variable-length record per event,
+// 9 bytes for translate and zoom and 13 for rotate, in host byte order.
+struct CameraPath
+{
+	glm::vec3 startPos;
+	float startYaw;
+	float startPitch;
+	float startFovY;
+	std::vector<CameraEvent> events;
+
+	bool save(const char* path) const;
+	bool load(const char* path);
+	float getDuration() const { return events.empty() ? 0.0f : events.back().time; }
+};
+
+// Captures the inputs main forwards to its Camera. Call setTime() once per
+// frame, then the same translate/rotate/zoom calls the camera receives.
+class CameraRecorder
+{
+public:
+	explicit CameraRecorder(Camera& start);
+
+	void setTime(double seconds) { time_ = (float)seconds; }
+	void translate(MoveDirection dir, float deltaTime);
+	void rotate(float offsetX, float offsetY);
+	void zoom(float offsetY);
+
+	const CameraPath& getPath() const { return path_; }
+
+private:
+	void add(CameraEventType type, MoveDirection dir, float a, float b);
+
+	CameraPath path_;
+	float time_;
+};
+
+// Plays a CameraPath back at a fixed timestep: frame n sees every event
+// recorded before (n + 1) * timestep. Translations carry their recorded
+// deltaTime, so the camera passes through exactly the recorded states no
+// matter how fast replay frames render.
+class CameraPlayer
+{
+public:
+	CameraPlayer(const CameraPath& path, float timestep);
+
+	// camera in the recorded start state, back at frame 0
+	Camera start();
+	// apply the next timestep of events, false once the path is exhausted
+	bool step(Camera& cam);
+
+	int getFrameCount() const;
+	int getFrame() const { return frame_; }
+
+private:
+	const CameraPath& path_;
+	float timestep_;
+	size_t next_;
+	int frame_;
+};
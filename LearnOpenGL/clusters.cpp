@@ -0,0 +1,345 @@
+#include "clusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+
+#define CLUSTERS_PER_SLICE (CLUSTER_X * CLUSTER_Y)
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+
+// brightest channel attenuated below this is dropped, one step of an 8 bit target
+static const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+float pointLightRadius(const PointLight& light)
+{
+	glm::vec3 brightest = glm::max(light.ambient, glm::max(light.diffuse, light.specular));
+	float peak = glm::max(brightest.x, glm::max(brightest.y, brightest.z));
+	// solve constant + linear * d + quadratic * d^2 = peak / cutoff
+	float c = light.constant - peak / LIGHT_CUTOFF;
+	if (c >= 0.0f)
+		return 0.0f;
+	if (light.quadratic <= 0.0f)
+		return light.linear > 0.0f ? -c / light.linear : INFINITY;
+	return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+static unsigned int createBufferTexture(unsigned int buffer, GLenum format)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	GLState::bindTexture(0, GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	return texture;
+}
+
+// orphan and refill, an empty buffer still gets one element so the texture stays valid
+static void uploadBuffer(unsigned int buffer, const void* data, size_t bytes, size_t elementBytes)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, bytes ? bytes : elementBytes, nullptr, GL_STREAM_DRAW);
+	if (bytes)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::LightClusters(ThreadPool& pool)
+	: pool_(pool),
+	  block_("Clusters", CLUSTERS_BLOCK_BINDING),
+	  fovY_(0.0f), aspect_(0.0f), zNear_(0.0f), zFar_(0.0f),
+	  width_(0), height_(0),
+	  sliceScale_(0.0f), sliceBias_(0.0f),
+	  maxTexels_(0),
+	  textureAlignment_(0),
+	  stats_()
+{
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels_);
+	if (GLExt::hasTextureBufferRange) {
+		GLint alignment = 0;
+		glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		textureAlignment_ = alignment > 0 ? (size_t)alignment : 1;
+	}
+	glGenBuffers(1, &lightBuffer_);
+	glGenBuffers(1, &rangeBuffer_);
+	glGenBuffers(1, &indexBuffer_);
+	uploadBuffer(lightBuffer_, nullptr, 0, 4 * sizeof(glm::vec4));
+	uploadBuffer(rangeBuffer_, nullptr, 0, 2 * sizeof(unsigned int));
+	uploadBuffer(indexBuffer_, nullptr, 0, sizeof(unsigned int));
+	lightTexture_ = createBufferTexture(lightBuffer_, GL_RGBA32F);
+	rangeTexture_ = createBufferTexture(rangeBuffer_, GL_RG32UI);
+	indexTexture_ = createBufferTexture(indexBuffer_, GL_R32UI);
+	clusterMin_.resize(CLUSTER_COUNT);
+	clusterMax_.resize(CLUSTER_COUNT);
+	ranges_.resize(2 * CLUSTER_COUNT);
+}
+
+LightClusters::~LightClusters()
+{
+	GLState::deleteTextures(1, &lightTexture_);
+	GLState::deleteTextures(1, &rangeTexture_);
+	GLState::deleteTextures(1, &indexTexture_);
+	glDeleteBuffers(1, &lightBuffer_);
+	glDeleteBuffers(1, &rangeBuffer_);
+	glDeleteBuffers(1, &indexBuffer_);
+}
+
+void LightClusters::setLights(const std::vector<PointLight>& lights)
+{
+	lights_ = lights;
+	size_t maxLights = (size_t)maxTexels_ / 4;
+	if (lights_.size() > maxLights) {
+		std::cout << "ERROR::CLUSTERS::TOO_MANY_LIGHTS " << lights_.size() << ", keeping " << maxLights << std::endl;
+		lights_.resize(maxLights);
+	}
+
+	radii_.resize(lights_.size());
+	std::vector<glm::vec4> texels(lights_.size() * 4);
+	for (size_t i = 0; i < lights_.size(); i++) {
+		const PointLight& light = lights_[i];
+		radii_[i] = pointLightRadius(light);
+		texels[i * 4 + 0] = glm::vec4(light.position, radii_[i]);
+		texels[i * 4 + 1] = glm::vec4(light.ambient, light.constant);
+		texels[i * 4 + 2] = glm::vec4(light.diffuse, light.linear);
+		texels[i * 4 + 3] = glm::vec4(light.specular, light.quadratic);
+	}
+	uploadBuffer(lightBuffer_, texels.data(), texels.size() * sizeof(glm::vec4), 4 * sizeof(glm::vec4));
+	bounds_.resize(lights_.size());
+}
+
+void LightClusters::bind(Shader& shader) const
+{
+	block_.bind(shader);
+	shader.use();
+	shader.setInt("pointLightData", CLUSTER_LIGHTS_UNIT);
+	shader.setInt("clusterRanges", CLUSTER_RANGES_UNIT);
+	shader.setInt("clusterLightIndices", CLUSTER_INDICES_UNIT);
+}
+
+void LightClusters::addTextures(Material& material) const
+{
+	material.add(CLUSTER_LIGHTS_UNIT, GL_TEXTURE_BUFFER, lightTexture_);
+	material.add(CLUSTER_RANGES_UNIT, GL_TEXTURE_BUFFER, rangeTexture_);
+	material.add(CLUSTER_INDICES_UNIT, GL_TEXTURE_BUFFER, indexTexture_);
+}
+
+int LightClusters::sliceOf(float depth) const
+{
+	int slice = (int)std::floor(std::log(depth) * sliceScale_ + sliceBias_);
+	return slice < 0 ? 0 : (slice >= CLUSTER_Z ? CLUSTER_Z - 1 : slice);
+}
+
+void LightClusters::rebuildClusterBounds()
+{
+	float logRatio = std::log(zFar_ / zNear_);
+	sliceScale_ = CLUSTER_Z / logRatio;
+	sliceBias_ = -CLUSTER_Z * std::log(zNear_) / logRatio;
+
+	float tanY = std::tan(fovY_ * 0.5f);
+	float tanX = tanY * aspect_;
+	for (int z = 0; z < CLUSTER_Z; z++) {
+		float depths[2] = {
+			zNear_ * std::pow(zFar_ / zNear_, (float)z / CLUSTER_Z),
+			zNear_ * std::pow(zFar_ / zNear_, (float)(z + 1) / CLUSTER_Z)
+		};
+		for (int y = 0; y < CLUSTER_Y; y++) {
+			for (int x = 0; x < CLUSTER_X; x++) {
+				float ndcX[2] = { -1.0f + 2.0f * x / CLUSTER_X, -1.0f + 2.0f * (x + 1) / CLUSTER_X };
+				float ndcY[2] = { -1.0f + 2.0f * y / CLUSTER_Y, -1.0f + 2.0f * (y + 1) / CLUSTER_Y };
+				glm::vec3 lo(INFINITY), hi(-INFINITY);
+				for (float d : depths)
+					for (float nx : ndcX)
+						for (float ny : ndcY) {
+							glm::vec3 corner(nx * d * tanX, ny * d * tanY, -d);
+							lo = glm::min(lo, corner);
+							hi = glm::max(hi, corner);
+						}
+				int cluster = x + y * CLUSTER_X + z * CLUSTERS_PER_SLICE;
+				clusterMin_[cluster] = lo;
+				clusterMax_[cluster] = hi;
+			}
+		}
+	}
+}
+
+static int tileOf(float ndc, int tiles)
+{
+	int tile = (int)std::floor((ndc * 0.5f + 0.5f) * tiles);
+	return tile < 0 ? 0 : (tile >= tiles ? tiles - 1 : tile);
+}
+
+// cluster range of one light: slices from its depth extent, tiles from the
+// screen rectangle of its view-space bounding box; z0 > z1 marks it culled
+void LightClusters::boundLight(size_t index, const glm::mat4& view)
+{
+	LightBounds& b = bounds_[index];
+	b.center = glm::vec3(view * glm::vec4(lights_[index].position, 1.0f));
+	b.radius = radii_[index];
+	b.z0 = 1;
+	b.z1 = 0;
+	float depth = -b.center.z;
+	if (b.radius <= 0.0f || depth + b.radius < zNear_ || depth - b.radius > zFar_)
+		return;
+
+	b.x0 = 0;
+	b.x1 = CLUSTER_X - 1;
+	b.y0 = 0;
+	b.y1 = CLUSTER_Y - 1;
+	if (depth - b.radius > zNear_) {
+		float tanY = std::tan(fovY_ * 0.5f);
+		float tanX = tanY * aspect_;
+		float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+		for (int i = 0; i < 8; i++) {
+			float x = b.center.x + ((i & 1) ? b.radius : -b.radius);
+			float y = b.center.y + ((i & 2) ? b.radius : -b.radius);
+			float d = depth + ((i & 4) ? b.radius : -b.radius);
+			float nx = x / (d * tanX);
+			float ny = y / (d * tanY);
+			minX = glm::min(minX, nx);
+			maxX = glm::max(maxX, nx);
+			minY = glm::min(minY, ny);
+			maxY = glm::max(maxY, ny);
+		}
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+			return;
+		b.x0 = tileOf(minX, CLUSTER_X);
+		b.x1 = tileOf(maxX, CLUSTER_X);
+		b.y0 = tileOf(minY, CLUSTER_Y);
+		b.y1 = tileOf(maxY, CLUSTER_Y);
+	}
+	b.z0 = sliceOf(glm::max(depth - b.radius, zNear_));
+	b.z1 = sliceOf(glm::min(depth + b.radius, zFar_));
+}
+
+static bool sphereTouchesBox(const glm::vec3& center, float radius, const glm::vec3& lo, const glm::vec3& hi)
+{
+	glm::vec3 closest = glm::max(lo, glm::min(center, hi));
+	glm::vec3 offset = closest - center;
+	return glm::dot(offset, offset) <= radius * radius;
+}
+
+// every slice writes only its own lists, so slices run in parallel without locks
+void LightClusters::assignSlice(int slice)
+{
+	std::vector<unsigned int>& counts = sliceCounts_[slice];
+	std::vector<unsigned int>& indices = sliceIndices_[slice];
+	counts.assign(CLUSTERS_PER_SLICE, 0);
+	indices.clear();
+
+	std::vector<unsigned int>& candidates = sliceCandidates_[slice];
+	candidates.clear();
+	for (size_t i = 0; i < bounds_.size(); i++)
+		if (bounds_[i].z0 <= slice && slice <= bounds_[i].z1)
+			candidates.push_back((unsigned int)i);
+	if (candidates.empty())
+		return;
+
+	for (int y = 0; y < CLUSTER_Y; y++) {
+		for (int x = 0; x < CLUSTER_X; x++) {
+			int local = x + y * CLUSTER_X;
+			int cluster = local + slice * CLUSTERS_PER_SLICE;
+			for (unsigned int i : candidates) {
+				const LightBounds& b = bounds_[i];
+				if (x < b.x0 || x > b.x1 || y < b.y0 || y > b.y1)
+					continue;
+				if (!sphereTouchesBox(b.center, b.radius, clusterMin_[cluster], clusterMax_[cluster]))
+					continue;
+				indices.push_back(i);
+				counts[local]++;
+			}
+		}
+	}
+}
+
+void LightClusters::streamTexture(StreamBuffer& stream, unsigned int texture, unsigned int buffer, GLenum format,
+	const void* data, size_t bytes, size_t elementBytes)
+{
+	// an empty range still gets one element so the texture stays valid
+	size_t size = bytes ? bytes : elementBytes;
+	if (textureAlignment_) {
+		GLintptr offset = 0;
+		void* mapped = stream.map(size, std::max(textureAlignment_, elementBytes), offset);
+		if (mapped && bytes)
+			memcpy(mapped, data, bytes);
+		stream.unmap();
+		GLState::bindTexture(0, GL_TEXTURE_BUFFER, texture);
+		if (mapped) {
+			GLExt::texBufferRange(GL_TEXTURE_BUFFER, format, stream.getBuffer(), offset, (GLsizeiptr)size);
+			return;
+		}
+		// the texture still views an older range of the ring
+		glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	}
+	uploadBuffer(buffer, data, bytes, elementBytes);
+}
+
+void LightClusters::update(const glm::mat4& view, float fovY, int width, int height, float zNear, float zFar,
+	StreamBuffer& stream)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	float aspect = (float)width / (float)height;
+	if (fovY != fovY_ || aspect != aspect_ || zNear != zNear_ || zFar != zFar_) {
+		fovY_ = fovY;
+		aspect_ = aspect;
+		zNear_ = zNear;
+		zFar_ = zFar;
+		rebuildClusterBounds();
+	}
+	width_ = width;
+	height_ = height;
+
+	pool_.parallelFor(lights_.size(), 256, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			boundLight(i, view);
+	});
+	pool_.parallelFor(CLUSTER_Z, 1, [&](size_t begin, size_t end) {
+		for (size_t slice = begin; slice < end; slice++)
+			assignSlice((int)slice);
+	});
+
+	// concatenate the slice lists, the buffer texture caps the total index count
+	stats_ = Stats();
+	indices_.clear();
+	for (int slice = 0; slice < CLUSTER_Z; slice++) {
+		const std::vector<unsigned int>& counts = sliceCounts_[slice];
+		const std::vector<unsigned int>& indices = sliceIndices_[slice];
+		size_t read = 0;
+		for (int local = 0; local < CLUSTERS_PER_SLICE; local++) {
+			unsigned int count = counts[local];
+			unsigned int offset = (unsigned int)indices_.size();
+			unsigned int kept = count;
+			if (offset + kept > (unsigned int)maxTexels_)
+				kept = (unsigned int)maxTexels_ - offset;
+			indices_.insert(indices_.end(), indices.begin() + read, indices.begin() + read + kept);
+			read += count;
+			int cluster = local + slice * CLUSTERS_PER_SLICE;
+			ranges_[2 * cluster] = offset;
+			ranges_[2 * cluster + 1] = kept;
+			stats_.droppedIndices += count - kept;
+			stats_.maxPerCluster = std::max(stats_.maxPerCluster, count);
+		}
+	}
+	for (const LightBounds& b : bounds_)
+		if (b.z0 <= b.z1)
+			stats_.lightsInRange++;
+	stats_.lights = (unsigned int)lights_.size();
+	stats_.indices = (unsigned int)indices_.size();
+
+	streamTexture(stream, rangeTexture_, rangeBuffer_, GL_RG32UI,
+		ranges_.data(), ranges_.size() * sizeof(unsigned int), 2 * sizeof(unsigned int));
+	streamTexture(stream, indexTexture_, indexBuffer_, GL_R32UI,
+		indices_.data(), indices_.size() * sizeof(unsigned int), sizeof(unsigned int));
+
+	ClustersBlock& data = block_.data;
+	data.count[0] = CLUSTER_X;
+	data.count[1] = CLUSTER_Y;
+	data.count[2] = CLUSTER_Z;
+	data.count[3] = (unsigned int)lights_.size();
+	data.depth = glm::vec4(zNear_, zFar_, sliceScale_, sliceBias_);
+	data.tile = glm::vec4((float)width_ / CLUSTER_X, (float)height_ / CLUSTER_Y, 0.0f, 0.0f);
+	block_.upload(stream);
+	stats_.assignMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
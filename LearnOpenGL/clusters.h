@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "render_queue.h"
+#include "scene_blocks.h"
+#include "shader.h"
+#include "stream_buffer.h"
+#include "thread_pool.h"
+
+// view frustum split into CLUSTER_X * CLUSTER_Y screen tiles and CLUSTER_Z
+// exponential depth slices
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+// texture units of the cluster buffers, after the material maps on 0 and 1
+#define CLUSTER_LIGHTS_UNIT 2
+#define CLUSTER_RANGES_UNIT 3
+#define CLUSTER_INDICES_UNIT 4
+
+struct PointLight
+{
+	glm::vec3 position;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float constant;
+	float linear;
+	float quadratic;
+};
+
+// distance where the attenuated light drops below 1/256 of its brightest channel
+float pointLightRadius(const PointLight& light);
+
+// Clustered forward lighting for any number of point lights. Every frame
+// update() assigns the lights to the clusters they touch on the thread pool
+// and fills three texture buffers:
+//   lights  RGBA32F, 4 texels per light: position + radius, ambient + constant,
+//           diffuse + linear, specular + quadratic
+//   ranges  RG32UI, first index and light count per cluster
+//   indices R32UI, light indices grouped by cluster
+// The lights only change with setLights(); the ranges, the indices and the
+// Clusters block are written to the stream buffer every frame, the textures
+// viewing their ranges of it. Without ARB_texture_buffer_range the textures
+// keep buffers of their own, orphaned and refilled per frame.
+// shader_box.fs looks up its cluster and only shades the lights listed there.
+// Requires a current GL context for its whole lifetime.
+class LightClusters
+{
+public:
+	struct Stats
+	{
+		unsigned int lights;
+		unsigned int lightsInRange;
+		unsigned int indices;
+		unsigned int maxPerCluster;
+		unsigned int droppedIndices;
+		double assignMs;
+	};
+
+	explicit LightClusters(ThreadPool& pool);
+	~LightClusters();
+
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	void setLights(const std::vector<PointLight>& lights);
+	const std::vector<PointLight>& getLights() const { return lights_; }
+
+	// assign lights for this view and write the buffers and the Clusters block
+	void update(const glm::mat4& view, float fovY, int width, int height, float zNear, float zFar,
+		StreamBuffer& stream);
+	// Clusters block binding and sampler units for a program using the cluster buffers
+	void bind(Shader& shader) const;
+	// the buffer textures at their units, for the material of a program using them
+	void addTextures(Material& material) const;
+
+	const Stats& getStats() const { return stats_; }
+	// the per frame buffers are ranges of the stream buffer rather than buffers of their own
+	bool isStreamed() const { return textureAlignment_ != 0; }
+
+private:
+	struct LightBounds
+	{
+		glm::vec3 center;
+		float radius;
+		int x0, x1, y0, y1, z0, z1;
+	};
+
+	void rebuildClusterBounds();
+	int sliceOf(float depth) const;
+	void boundLight(size_t index, const glm::mat4& view);
+	void assignSlice(int slice);
+	// point texture at this frame's data, in stream or else in its own buffer
+	void streamTexture(StreamBuffer& stream, unsigned int texture, unsigned int buffer, GLenum format,
+		const void* data, size_t bytes, size_t elementBytes);
+
+	ThreadPool& pool_;
+	UniformBlock<ClustersBlock> block_;
+	std::vector<PointLight> lights_;
+	std::vector<float> radii_;
+
+	// view-space AABB of every cluster, rebuilt when the projection changes
+	float fovY_, aspect_, zNear_, zFar_;
+	int width_, height_;
+	std::vector<glm::vec3> clusterMin_;
+	std::vector<glm::vec3> clusterMax_;
+	float sliceScale_, sliceBias_;
+
+	std::vector<LightBounds> bounds_;
+	// per slice: light count of each of its clusters, then the light indices in cluster order
+	std::vector<unsigned int> sliceCounts_[CLUSTER_Z];
+	std::vector<unsigned int> sliceIndices_[CLUSTER_Z];
+	// lights whose depth range covers the slice, kept to reuse the allocation
+	std::vector<unsigned int> sliceCandidates_[CLUSTER_Z];
+	std::vector<unsigned int> ranges_;
+	std::vector<unsigned int> indices_;
+
+	GLint maxTexels_;
+	// GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, 0 without ARB_texture_buffer_range
+	size_t textureAlignment_;
+	unsigned int lightBuffer_, rangeBuffer_, indexBuffer_;
+	unsigned int lightTexture_, rangeTexture_, indexTexture_;
+	Stats stats_;
+};
@@ -0,0 +1,247 @@
+#include "context.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+static double steadySeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RenderContext::RenderContext()
+	: backend_(BACKEND_WINDOW),
+	  width_(0),
+	  height_(0),
+	  closeRequested_(false),
+	  window_(nullptr),
+	  eglDisplay_(nullptr),
+	  eglContext_(nullptr),
+	  fbo_(0),
+	  colorRbo_(0),
+	  depthRbo_(0),
+	  startTime_(0.0)
+{
+}
+
+bool RenderContext::init(ContextBackend backend, int width, int height)
+{
+	backend_ = backend;
+	width_ = width;
+	height_ = height;
+	startTime_ = steadySeconds();
+	// a new context starts from defaults the shadow may not match
+	GLState::invalidate();
+	if (backend_ == BACKEND_WINDOW)
+		return initWindow();
+	return initHeadless() && createFramebuffer();
+}
+
+bool RenderContext::initWindow()
+{
+	// initailize glfw
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	window_ = glfwCreateWindow(width_, height_, "LearnOpenGL", NULL, NULL);
+	if (window_ == nullptr) {
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+
+	glfwMakeContextCurrent(window_);
+
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return false;
+	}
+	GLExt::load((GLADloadproc)glfwGetProcAddress);
+	return true;
+}
+
+#if defined(__linux__)
+bool RenderContext::initHeadless()
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		std::cout << "Failed to initialize EGL display" << std::endl;
+		return false;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	const EGLint configAttribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+		config = EGL_NO_CONFIG_KHR;
+
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT)
+	{
+		std::cout << "Failed to create EGL context: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		eglTerminate(display);
+		return false;
+	}
+	// surfaceless: the context has no default framebuffer, everything goes to our FBO
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		std::cout << "Failed to make EGL context current" << std::endl;
+		eglDestroyContext(display, context);
+		eglTerminate(display);
+		return false;
+	}
+	eglDisplay_ = display;
+	eglContext_ = context;
+
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return false;
+	}
+	GLExt::load((GLADloadproc)eglGetProcAddress);
+	std::cout << "Headless EGL " << major << "." << minor << ": "
+		<< glGetString(GL_RENDERER) << " | " << glGetString(GL_VERSION) << std::endl;
+	return true;
+}
+#else
+bool RenderContext::initHeadless()
+{
+	std::cout << "Headless rendering is only supported on Linux" << std::endl;
+	return false;
+}
+#endif
+
+bool RenderContext::createFramebuffer()
+{
+	glGenFramebuffers(1, &fbo_);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+
+	glGenRenderbuffers(1, &colorRbo_);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRbo_);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRbo_);
+
+	glGenRenderbuffers(1, &depthRbo_);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRbo_);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width_, height_);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRbo_);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::FRAMEBUFFER:: Offscreen framebuffer is not complete" << std::endl;
+		return false;
+	}
+	glViewport(0, 0, width_, height_);
+	return true;
+}
+
+void RenderContext::terminate()
+{
+	if (fbo_)
+	{
+		glDeleteFramebuffers(1, &fbo_);
+		glDeleteRenderbuffers(1, &colorRbo_);
+		glDeleteRenderbuffers(1, &depthRbo_);
+		fbo_ = colorRbo_ = depthRbo_ = 0;
+	}
+	if (backend_ == BACKEND_WINDOW)
+	{
+		glfwTerminate();
+		window_ = nullptr;
+		return;
+	}
+#if defined(__linux__)
+	if (eglDisplay_)
+	{
+		eglMakeCurrent((EGLDisplay)eglDisplay_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext((EGLDisplay)eglDisplay_, (EGLContext)eglContext_);
+		eglTerminate((EGLDisplay)eglDisplay_);
+		eglDisplay_ = eglContext_ = nullptr;
+	}
+#endif
+}
+
+bool RenderContext::shouldClose() const
+{
+	if (closeRequested_)
+		return true;
+	return window_ != nullptr && glfwWindowShouldClose(window_);
+}
+
+void RenderContext::requestClose()
+{
+	closeRequested_ = true;
+}
+
+void RenderContext::swapBuffers()
+{
+	if (window_)
+		glfwSwapBuffers(window_);
+	else
+		glFlush();
+}
+
+void RenderContext::pollEvents()
+{
+	if (window_)
+		glfwPollEvents();
+}
+
+double RenderContext::getTime() const
+{
+	if (window_)
+		return glfwGetTime();
+	return steadySeconds() - startTime_;
+}
+
+bool RenderContext::saveFrame(const char* path) const
+{
+	std::vector<unsigned char> pixels((size_t)width_ * height_ * 3);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		std::cout << "Failed to write frame: " << path << std::endl;
+		return false;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", width_, height_);
+	// GL rows start at the bottom
+	for (int y = height_ - 1; y >= 0; y--)
+		fwrite(&pixels[(size_t)y * width_ * 3], 1, (size_t)width_ * 3, file);
+	fclose(file);
+	return true;
+}
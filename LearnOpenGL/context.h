@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+enum ContextBackend
+{
+	BACKEND_WINDOW,		// GLFW window on the default framebuffer
+	BACKEND_HEADLESS	// surfaceless EGL context rendering into an offscreen FBO (Linux only)
+};
+
+// Owns the GL context the renderer draws into. With the headless backend no
+// display server is needed: Mesa's surfaceless platform (llvmpipe on GPU-less
+// machines) provides the context and frames land in an FBO instead of a window.
+class RenderContext
+{
+public:
+	RenderContext();
+
+	bool init(ContextBackend backend, int width, int height);
+	void terminate();
+
+	bool shouldClose() const;
+	void requestClose();
+	// present the frame: swap the window, or finish the offscreen frame
+	void swapBuffers();
+	void pollEvents();
+	double getTime() const;
+	// write the current frame as a binary PPM
+	bool saveFrame(const char* path) const;
+
+	ContextBackend getBackend() const { return backend_; }
+	GLFWwindow* getWindow() const { return window_; }
+	int getWidth() const { return width_; }
+	int getHeight() const { return height_; }
+
+private:
+	bool initWindow();
+	bool initHeadless();
+	bool createFramebuffer();
+
+	ContextBackend backend_;
+	int width_;
+	int height_;
+	bool closeRequested_;
+	GLFWwindow* window_;
+	void* eglDisplay_;
+	void* eglContext_;
+	unsigned int fbo_;
+	unsigned int colorRbo_;
+	unsigned int depthRbo_;
+	double startTime_;
+};
@@ -0,0 +1,191 @@
+#include "culling.h"
+
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+// AVX functions are compiled for AVX on their own and only called after a CPUID check
+#if defined(CULLING_SSE) && defined(__GNUC__)
+#include <immintrin.h>
+#define CULLING_AVX 1
+#define AVX_TARGET __attribute__((target("avx")))
+#elif defined(CULLING_SSE) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#define CULLING_AVX 1
+#define AVX_TARGET
+#endif
+
+Frustum extractFrustum(const glm::mat4& viewProject)
+{
+	// rows of the matrix, glm stores columns
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProject[0][i], viewProject[1][i], viewProject[2][i], viewProject[3][i]);
+
+	// -w <= x, y, z <= w
+	Frustum frustum;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		frustum.planes[axis * 2] = rows[3] + rows[axis];
+		frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+	}
+	for (glm::vec4& plane : frustum.planes)
+		plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+	return frustum;
+}
+
+void BoundingSpheres::resize(size_t newCount)
+{
+	count = newCount;
+	size_t padded = (newCount + CULL_BATCH - 1) / CULL_BATCH * CULL_BATCH;
+	x.assign(padded, 0.0f);
+	y.assign(padded, 0.0f);
+	z.assign(padded, 0.0f);
+	// further outside every plane than any distance can be
+	radius.assign(padded, -FLT_MAX);
+}
+
+#ifdef CULLING_AVX
+static bool cpuHasAvx()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	// AVX and OSXSAVE, then the OS has to save the YMM registers
+	bool avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27));
+	return avx && (_xgetbv(0) & 6) == 6;
+#else
+	return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+CullPath bestCullPath()
+{
+#ifdef CULLING_AVX
+	static const bool avx = cpuHasAvx();
+	if (avx)
+		return CULL_AVX;
+#endif
+#ifdef CULLING_SSE
+	return CULL_SSE;
+#else
+	return CULL_SCALAR;
+#endif
+}
+
+const char* cullPathName(CullPath path)
+{
+	switch (path)
+	{
+	case CULL_AVX: return "avx";
+	case CULL_SSE: return "sse";
+	default: return "scalar";
+	}
+}
+
+static size_t cullScalar(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < spheres.count; i++)
+	{
+		bool inside = true;
+		for (const glm::vec4& p : frustum.planes)
+			inside &= p.x * spheres.x[i] + p.y * spheres.y[i] + p.z * spheres.z[i] + p.w >= -spheres.radius[i];
+		visible[n] = (unsigned int)i;
+		n += inside;
+	}
+	return n;
+}
+
+#ifdef CULLING_SSE
+static size_t cullSse(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible)
+{
+	__m128 planes[6][4];
+	for (int k = 0; k < 6; k++)
+		for (int c = 0; c < 4; c++)
+			planes[k][c] = _mm_set1_ps(frustum.planes[k][c]);
+
+	size_t n = 0;
+	const size_t padded = spheres.x.size();
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&spheres.x[i]);
+		__m128 y = _mm_loadu_ps(&spheres.y[i]);
+		__m128 z = _mm_loadu_ps(&spheres.z[i]);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int k = 0; k < 6; k++)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[k][0], x), _mm_mul_ps(planes[k][1], y)),
+				_mm_add_ps(_mm_mul_ps(planes[k][2], z), planes[k][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negRadius));
+		}
+		int bits = _mm_movemask_ps(inside);
+		// a whole batch outside is the common case far from the camera
+		if (bits == 0)
+			continue;
+		// branchless compaction, every lane is written and only visible ones advance
+		for (int lane = 0; lane < 4; lane++)
+		{
+			visible[n] = (unsigned int)(i + lane);
+			n += (bits >> lane) & 1;
+		}
+	}
+	return n;
+}
+#endif
+
+#ifdef CULLING_AVX
+AVX_TARGET static size_t cullAvx(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible)
+{
+	__m256 planes[6][4];
+	for (int k = 0; k < 6; k++)
+		for (int c = 0; c < 4; c++)
+			planes[k][c] = _mm256_set1_ps(frustum.planes[k][c]);
+
+	size_t n = 0;
+	const size_t padded = spheres.x.size();
+	for (size_t i = 0; i < padded; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&spheres.x[i]);
+		__m256 y = _mm256_loadu_ps(&spheres.y[i]);
+		__m256 z = _mm256_loadu_ps(&spheres.z[i]);
+		__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int k = 0; k < 6; k++)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[k][0], x), _mm256_mul_ps(planes[k][1], y)),
+				_mm256_add_ps(_mm256_mul_ps(planes[k][2], z), planes[k][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negRadius, _CMP_GE_OQ));
+		}
+		int bits = _mm256_movemask_ps(inside);
+		if (bits == 0)
+			continue;
+		for (int lane = 0; lane < 8; lane++)
+		{
+			visible[n] = (unsigned int)(i + lane);
+			n += (bits >> lane) & 1;
+		}
+	}
+	return n;
+}
+#endif
+
+size_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible, CullPath path)
+{
+#ifdef CULLING_AVX
+	if (path == CULL_AVX && bestCullPath() == CULL_AVX)
+		return cullAvx(frustum, spheres, visible);
+#endif
+#ifdef CULLING_SSE
+	if (path != CULL_SCALAR)
+		return cullSse(frustum, spheres, visible);
+#endif
+	return cullScalar(frustum, spheres, visible);
+}
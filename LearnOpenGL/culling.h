@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// spheres are tested in batches of this many, the widest SIMD path
+#define CULL_BATCH 8
+
+// six planes (left, right, bottom, top, near, far) facing inwards, normalized
+// so that dot(plane, vec4(p, 1)) is the signed distance of p
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+// planes of the clip volume of viewProject, in the space its input is in:
+// world space for project * view
+Frustum extractFrustum(const glm::mat4& viewProject);
+
+// Bounding spheres in structure-of-arrays layout, padded to a multiple of
+// CULL_BATCH with spheres that are never visible so the SIMD loops need no tail.
+struct BoundingSpheres
+{
+	std::vector<float> x, y, z, radius;
+	size_t count = 0;
+
+	void resize(size_t count);
+	void set(size_t i, const glm::vec3& center, float r)
+	{
+		x[i] = center.x;
+		y[i] = center.y;
+		z[i] = center.z;
+		radius[i] = r;
+	}
+};
+
+enum CullPath
+{
+	CULL_SCALAR,
+	CULL_SSE,
+	CULL_AVX,
+};
+
+// widest path this CPU runs, AVX is picked at run time so the build needs no -mavx
+CullPath bestCullPath();
+const char* cullPathName(CullPath path);
+
+// Write the indices of the spheres touching the frustum to visible, in
+// increasing order, and return how many there are. visible must have room
+// for the padded size of spheres (spheres.x.size()). A path the CPU or the
+// build lacks falls back to the next narrower one.
+size_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible,
+	CullPath path = bestCullPath());
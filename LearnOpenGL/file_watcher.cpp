@@ -0,0 +1,112 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#ifndef __linux__
+static long long modificationTime(const std::string& path)
+{
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return -1;
+	return (long long)info.st_mtime;
+}
+#endif
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+	fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd_ < 0)
+		std::cout << "ERROR::FILE_WATCHER::INOTIFY_INIT_FAILED errno " << errno << std::endl;
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (fd_ >= 0)
+		close(fd_);
+#endif
+}
+
+bool FileWatcher::isNative() const
+{
+#ifdef __linux__
+	return fd_ >= 0;
+#else
+	return false;
+#endif
+}
+
+void FileWatcher::watch(const std::string& path)
+{
+	if (!files_.insert(path).second)
+		return;
+#ifdef __linux__
+	if (fd_ < 0)
+		return;
+	size_t slash = path.find_last_of('/');
+	std::string prefix = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	std::string directory = prefix.empty() ? "." : prefix;
+	// CLOSE_WRITE: written in place, MOVED_TO: renamed over the old file
+	int wd = inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0)
+		std::cout << "ERROR::FILE_WATCHER::WATCH_FAILED " << directory << " errno " << errno << std::endl;
+	else
+	{
+		std::vector<std::string>& prefixes = directories_[wd];
+		if (std::find(prefixes.begin(), prefixes.end(), prefix) == prefixes.end())
+			prefixes.push_back(prefix);
+	}
+#else
+	modified_[path] = modificationTime(path);
+#endif
+}
+
+void FileWatcher::poll(std::vector<std::string>& changed)
+{
+	changed.clear();
+#ifdef __linux__
+	if (fd_ < 0)
+		return;
+	alignas(inotify_event) char buffer[4096];
+	for (;;) {
+		ssize_t length = read(fd_, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+		for (ssize_t offset = 0; offset < length;) {
+			const inotify_event* event = (const inotify_event*)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+			auto directory = directories_.find(event->wd);
+			if (directory == directories_.end() || event->len == 0)
+				continue;
+			for (const std::string& prefix : directory->second) {
+				std::string path = prefix + event->name;
+				// a directory holds files that are not watched, and a save can raise several events
+				if (files_.count(path) && std::find(changed.begin(), changed.end(), path) == changed.end())
+					changed.push_back(path);
+			}
+		}
+	}
+#else
+	for (auto& entry : modified_) {
+		long long time = modificationTime(entry.first);
+		if (time != entry.second) {
+			entry.second = time;
+			// deleted for the moment, most likely an editor in the middle of saving
+			if (time >= 0)
+				changed.push_back(entry.first);
+		}
+	}
+#endif
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Reports watched files that changed on disk, without ever blocking. On Linux
+// it is inotify on the parent directories, so editors that save through a
+// temporary file and a rename are caught as well; elsewhere every poll()
+// compares modification times.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// path as it will be reported, relative to the working directory is fine
+	void watch(const std::string& path);
+	// replace changed with the watched paths written since the last call,
+	// each at most once; cheap and allocation free while nothing changes
+	void poll(std::vector<std::string>& changed);
+	// inotify is in use rather than modification time polling
+	bool isNative() const;
+
+private:
+	std::set<std::string> files_;
+#ifdef __linux__
+	int fd_;
+	// watch descriptor to the directory prefixes its events are reported under;
+	// one directory spelled two ways ("a/" and "./a/") shares a descriptor
+	std::map<int, std::vector<std::string>> directories_;
+#else
+	std::map<std::string, long long> modified_;
+#endif
+};
@@ -0,0 +1,106 @@
+#include "gl_ext.h"
+
+#include <cstring>
+
+bool GLExt::hasProgramBinary = false;
+
+GLExtGetProgramBinaryProc GLExt::getProgramBinary = nullptr;
+GLExtProgramBinaryProc GLExt::programBinary = nullptr;
+GLExtProgramParameteriProc GLExt::programParameteri = nullptr;
+
+bool GLExt::hasParallelShaderCompile = false;
+
+GLExtMaxShaderCompilerThreadsProc GLExt::maxShaderCompilerThreads = nullptr;
+
+bool GLExt::hasComputeShader = false;
+
+GLExtDispatchComputeProc GLExt::dispatchCompute = nullptr;
+GLExtMemoryBarrierProc GLExt::memoryBarrier = nullptr;
+
+bool GLExt::hasMultiDrawIndirect = false;
+
+GLExtMultiDrawElementsIndirectProc GLExt::multiDrawElementsIndirect = nullptr;
+
+bool GLExt::hasIndirectParameters = false;
+
+GLExtMultiDrawElementsIndirectCountProc GLExt::multiDrawElementsIndirectCount = nullptr;
+
+bool GLExt::hasBufferStorage = false;
+
+GLExtBufferStorageProc GLExt::bufferStorage = nullptr;
+
+bool GLExt::hasBaseInstance = false;
+
+GLExtDrawElementsInstancedBaseVertexBaseInstanceProc GLExt::drawElementsInstancedBaseVertexBaseInstance = nullptr;
+
+bool GLExt::hasTextureBufferRange = false;
+
+GLExtTexBufferRangeProc GLExt::texBufferRange = nullptr;
+
+int GLExt::version_ = 0;
+
+bool GLExt::hasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+void GLExt::load(GLADloadproc loader)
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	version_ = major * 10 + minor;
+
+	if (version_ >= 41 || hasExtension("GL_ARB_get_program_binary")) {
+		getProgramBinary = (GLExtGetProgramBinaryProc)loader("glGetProgramBinary");
+		programBinary = (GLExtProgramBinaryProc)loader("glProgramBinary");
+		programParameteri = (GLExtProgramParameteriProc)loader("glProgramParameteri");
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		hasProgramBinary = getProgramBinary && programBinary && programParameteri && formats > 0;
+	}
+
+	// both extensions share the enums, only the entry point name differs
+	if (hasExtension("GL_KHR_parallel_shader_compile"))
+		maxShaderCompilerThreads = (GLExtMaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsKHR");
+	else if (hasExtension("GL_ARB_parallel_shader_compile"))
+		maxShaderCompilerThreads = (GLExtMaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsARB");
+	hasParallelShaderCompile = maxShaderCompilerThreads != nullptr;
+
+	if (version_ >= 43 || (hasExtension("GL_ARB_compute_shader") && hasExtension("GL_ARB_shader_storage_buffer_object"))) {
+		dispatchCompute = (GLExtDispatchComputeProc)loader("glDispatchCompute");
+		memoryBarrier = (GLExtMemoryBarrierProc)loader("glMemoryBarrier");
+		hasComputeShader = dispatchCompute && memoryBarrier;
+	}
+
+	if (version_ >= 43 || (hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance"))) {
+		multiDrawElementsIndirect = (GLExtMultiDrawElementsIndirectProc)loader("glMultiDrawElementsIndirect");
+		hasMultiDrawIndirect = multiDrawElementsIndirect != nullptr;
+	}
+
+	// the core 4.6 entry point takes the same arguments as the ARB one
+	if (version_ >= 46)
+		multiDrawElementsIndirectCount = (GLExtMultiDrawElementsIndirectCountProc)loader("glMultiDrawElementsIndirectCount");
+	else if (hasExtension("GL_ARB_indirect_parameters"))
+		multiDrawElementsIndirectCount = (GLExtMultiDrawElementsIndirectCountProc)loader("glMultiDrawElementsIndirectCountARB");
+	hasIndirectParameters = multiDrawElementsIndirectCount != nullptr;
+
+	if (version_ >= 44 || hasExtension("GL_ARB_buffer_storage"))
+		bufferStorage = (GLExtBufferStorageProc)loader("glBufferStorage");
+	hasBufferStorage = bufferStorage != nullptr;
+
+	if (version_ >= 42 || hasExtension("GL_ARB_base_instance"))
+		drawElementsInstancedBaseVertexBaseInstance = (GLExtDrawElementsInstancedBaseVertexBaseInstanceProc)loader("glDrawElementsInstancedBaseVertexBaseInstance");
+	hasBaseInstance = drawElementsInstancedBaseVertexBaseInstance != nullptr;
+
+	if (version_ >= 43 || hasExtension("GL_ARB_texture_buffer_range"))
+		texBufferRange = (GLExtTexBufferRangeProc)loader("glTexBufferRange");
+	hasTextureBufferRange = texBufferRange != nullptr;
+}
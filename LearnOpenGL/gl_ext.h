@@ -0,0 +1,127 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// glad is generated for the 3.3 core profile without extensions. Entry points
+// from newer versions or extensions are loaded here with the same loader, and
+// every user checks the matching has* flag first since the context may be 3.3.
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_PARAMETER_BUFFER_ARB
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+#endif
+#ifndef GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT
+#define GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT 0x919F
+#endif
+
+typedef void (APIENTRYP GLExtGetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP GLExtProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP GLExtProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP GLExtMaxShaderCompilerThreadsProc)(GLuint count);
+typedef void (APIENTRYP GLExtDrawElementsInstancedBaseVertexBaseInstanceProc)(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instanceCount, GLint baseVertex, GLuint baseInstance);
+typedef void (APIENTRYP GLExtBufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP GLExtDispatchComputeProc)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP GLExtMemoryBarrierProc)(GLbitfield barriers);
+typedef void (APIENTRYP GLExtMultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+typedef void (APIENTRYP GLExtMultiDrawElementsIndirectCountProc)(GLenum mode, GLenum type, const void *indirect, GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+typedef void (APIENTRYP GLExtTexBufferRangeProc)(GLenum target, GLenum internalFormat, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+class GLExt
+{
+public:
+	// GL 4.1 or ARB_get_program_binary, with at least one binary format
+	static bool hasProgramBinary;
+
+	static GLExtGetProgramBinaryProc getProgramBinary;
+	static GLExtProgramBinaryProc programBinary;
+	static GLExtProgramParameteriProc programParameteri;
+
+	// KHR_parallel_shader_compile (or the older ARB one): compiles and links run
+	// on driver threads and GL_COMPLETION_STATUS_KHR can be polled without blocking
+	static bool hasParallelShaderCompile;
+
+	static GLExtMaxShaderCompilerThreadsProc maxShaderCompilerThreads;
+
+	// GL 4.3, or ARB_compute_shader with ARB_shader_storage_buffer_object
+	static bool hasComputeShader;
+
+	static GLExtDispatchComputeProc dispatchCompute;
+	static GLExtMemoryBarrierProc memoryBarrier;
+
+	// GL 4.3, or ARB_multi_draw_indirect with ARB_base_instance: the commands
+	// may start their instanced attributes at baseInstance
+	static bool hasMultiDrawIndirect;
+
+	static GLExtMultiDrawElementsIndirectProc multiDrawElementsIndirect;
+
+	// GL 4.6 or ARB_indirect_parameters: the draw count is read from a
+	// GL_PARAMETER_BUFFER_ARB, so it can be written by the GPU
+	static bool hasIndirectParameters;
+
+	static GLExtMultiDrawElementsIndirectCountProc multiDrawElementsIndirectCount;
+
+	// GL 4.4 or ARB_buffer_storage: immutable buffers that can stay mapped
+	// (GL_MAP_PERSISTENT_BIT) while the GPU reads them
+	static bool hasBufferStorage;
+
+	static GLExtBufferStorageProc bufferStorage;
+
+	// GL 4.2 or ARB_base_instance: instanced attributes start at baseInstance,
+	// so one attribute setup can draw any slice of its buffer
+	static bool hasBaseInstance;
+
+	static GLExtDrawElementsInstancedBaseVertexBaseInstanceProc drawElementsInstancedBaseVertexBaseInstance;
+
+	// GL 4.3 or ARB_texture_buffer_range: a buffer texture may view part of a
+	// buffer, at offsets aligned to GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT
+	static bool hasTextureBufferRange;
+
+	static GLExtTexBufferRangeProc texBufferRange;
+
+	// call once the context is current and glad is loaded
+	static void load(GLADloadproc loader);
+	static bool hasExtension(const char* name);
+	// context version as major * 10 + minor, 33 for 3.3
+	static int getVersion() { return version_; }
+
+private:
+	static int version_;
+};
@@ -0,0 +1,151 @@
+#include "gl_state.h"
+
+#include <cstring>
+
+// shadowed texture targets
+#define TARGET_2D 0
+#define TARGET_BUFFER 1
+#define TARGET_COUNT 2
+
+// capabilities this renderer toggles
+static const GLenum trackedCaps[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_STENCIL_TEST };
+
+// an unknown value never matches, so the first call after invalidate() always goes through
+static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+static GLuint currentProgram = UNKNOWN;
+static GLuint currentVertexArray = UNKNOWN;
+static GLuint activeUnit = UNKNOWN;
+// zero matches a fresh context, where every unit has texture 0 bound
+static GLuint boundTextures[GL_STATE_TEXTURE_UNITS][TARGET_COUNT];
+// 0 disabled, 1 enabled, 2 unknown
+static unsigned char capStates[sizeof(trackedCaps) / sizeof(trackedCaps[0])] = { 2, 2, 2, 2 };
+
+GLState::Stats GLState::stats = {};
+
+void GLState::resetStats()
+{
+	stats = Stats();
+}
+
+void GLState::invalidate()
+{
+	currentProgram = UNKNOWN;
+	currentVertexArray = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (GLuint unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+		for (int target = 0; target < TARGET_COUNT; target++)
+			boundTextures[unit][target] = UNKNOWN;
+	memset(capStates, 2, sizeof(capStates));
+}
+
+static int targetIndex(GLenum target)
+{
+	if (target == GL_TEXTURE_2D)
+		return TARGET_2D;
+	if (target == GL_TEXTURE_BUFFER)
+		return TARGET_BUFFER;
+	return -1;
+}
+
+static int capIndex(GLenum cap)
+{
+	for (int i = 0; i < (int)(sizeof(trackedCaps) / sizeof(trackedCaps[0])); i++)
+		if (trackedCaps[i] == cap)
+			return i;
+	return -1;
+}
+
+void GLState::useProgram(GLuint program)
+{
+	if (program == currentProgram) {
+		stats.programs.filtered++;
+		return;
+	}
+	glUseProgram(program);
+	currentProgram = program;
+	stats.programs.issued++;
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+	if (vao == currentVertexArray) {
+		stats.vertexArrays.filtered++;
+		return;
+	}
+	glBindVertexArray(vao);
+	currentVertexArray = vao;
+	stats.vertexArrays.issued++;
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	int index = targetIndex(target);
+	bool shadowed = index >= 0 && unit < GL_STATE_TEXTURE_UNITS;
+	if (shadowed && boundTextures[unit][index] == texture) {
+		stats.textures.filtered++;
+		return;
+	}
+	if (unit != activeUnit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+	glBindTexture(target, texture);
+	if (shadowed)
+		boundTextures[unit][index] = texture;
+	stats.textures.issued++;
+}
+
+static void setCap(GLenum cap, bool enabled)
+{
+	int index = capIndex(cap);
+	if (index >= 0 && capStates[index] == (enabled ? 1 : 0)) {
+		GLState::stats.capabilities.filtered++;
+		return;
+	}
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	if (index >= 0)
+		capStates[index] = enabled ? 1 : 0;
+	GLState::stats.capabilities.issued++;
+}
+
+void GLState::enable(GLenum cap)
+{
+	setCap(cap, true);
+}
+
+void GLState::disable(GLenum cap)
+{
+	setCap(cap, false);
+}
+
+// GL unbinds deleted objects from the current context, mirror that
+void GLState::deleteTextures(GLsizei count, const GLuint* textures)
+{
+	for (GLsizei i = 0; i < count; i++)
+		for (GLuint unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+			for (int target = 0; target < TARGET_COUNT; target++)
+				if (boundTextures[unit][target] == textures[i])
+					boundTextures[unit][target] = 0;
+	glDeleteTextures(count, textures);
+}
+
+void GLState::deleteVertexArrays(GLsizei count, const GLuint* vaos)
+{
+	for (GLsizei i = 0; i < count; i++)
+		if (currentVertexArray == vaos[i])
+			currentVertexArray = 0;
+	glDeleteVertexArrays(count, vaos);
+}
+
+void GLState::deleteProgram(GLuint program)
+{
+	// a deleted program stays current until something else is used, so the
+	// binding is not known to be 0, only that the name may come back recycled
+	if (currentProgram == program)
+		currentProgram = UNKNOWN;
+	glDeleteProgram(program);
+}
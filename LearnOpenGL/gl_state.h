@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// texture units shadowed by GLState, binds to higher units go straight to GL
+#define GL_STATE_TEXTURE_UNITS 16
+
+// Shadow copy of the binding state the renderer changes every frame: current
+// program, vertex array, the texture bound to each unit and target, and
+// enabled capabilities. Calls that would not change anything never reach the
+// driver. There is one GL context per process, so the shadow is global.
+// Everything that binds these objects must go through GLState, and deletes
+// must use the wrappers below so a recycled name is not mistaken for bound.
+class GLState
+{
+public:
+	struct Counter
+	{
+		unsigned int issued;
+		unsigned int filtered;
+	};
+	// calls issued to the driver and calls dropped as redundant
+	struct Stats
+	{
+		Counter programs;
+		Counter vertexArrays;
+		Counter textures;
+		Counter capabilities;
+	};
+	static Stats stats;
+	static void resetStats();
+
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vao);
+	// GL_TEXTURE_2D and GL_TEXTURE_BUFFER are shadowed, other targets pass through
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	static void enable(GLenum cap);
+	static void disable(GLenum cap);
+
+	static void deleteTextures(GLsizei count, const GLuint* textures);
+	static void deleteVertexArrays(GLsizei count, const GLuint* vaos);
+	static void deleteProgram(GLuint program);
+
+	// forget everything, after a context is created or foreign code touched GL
+	static void invalidate();
+};
@@ -0,0 +1,87 @@
+#include "hot_reload.h"
+
+#include <iostream>
+
+#include "gl_state.h"
+
+HotReload::HotReload(ShaderBatch& batch, TextureLoader& textures)
+	: batch_(batch), textures_(textures), rebuilding_(0), stats_()
+{
+}
+
+HotReload::~HotReload()
+{
+	// the batch must not keep pointers to rebuilds that are about to go away
+	batch_.finish();
+	for (WatchedShader& watched : shaders_)
+		if (watched.rebuild)
+			GLState::deleteProgram(watched.rebuild->id);
+}
+
+void HotReload::watchShader(Shader& shader, std::function<void(Shader&)> onReload)
+{
+	for (const WatchedShader& watched : shaders_)
+		if (watched.shader == &shader)
+			return;
+	shaders_.push_back({ &shader, std::move(onReload), nullptr, false });
+	watcher_.watch(shader.getVertexPath());
+	watcher_.watch(shader.getFragPath());
+}
+
+void HotReload::watchTexture(const char* path, unsigned int texture)
+{
+	textureFiles_.push_back({ path, texture });
+	watcher_.watch(path);
+}
+
+void HotReload::finishRebuild(WatchedShader& watched)
+{
+	Shader& rebuild = *watched.rebuild;
+	if (rebuild.isLinked()) {
+		// the Shader object stays where it is, only its program and uniform table change
+		watched.shader->swap(rebuild);
+		if (watched.onReload)
+			watched.onReload(*watched.shader);
+		stats_.shaderReloads++;
+		std::cout << "Reloaded " << watched.shader->getVertexPath() << " + " << watched.shader->getFragPath() << std::endl;
+	}
+	else {
+		stats_.shaderFailures++;
+		std::cout << "ERROR::HOT_RELOAD::KEEPING_OLD_PROGRAM " << rebuild.getVertexPath() << " + " << rebuild.getFragPath() << std::endl;
+	}
+	// after the swap this is the old program
+	GLState::deleteProgram(rebuild.id);
+	watched.rebuild.reset();
+	rebuilding_--;
+}
+
+void HotReload::update()
+{
+	watcher_.poll(changed_);
+	for (const std::string& path : changed_) {
+		for (WatchedShader& watched : shaders_)
+			if (path == watched.shader->getVertexPath() || path == watched.shader->getFragPath())
+				watched.dirty = true;
+		for (const WatchedTexture& watched : textureFiles_)
+			if (path == watched.path) {
+				textures_.reload(watched.texture, watched.path.c_str());
+				stats_.textureReloads++;
+			}
+	}
+
+	if (rebuilding_ > 0)
+		batch_.poll();
+	for (WatchedShader& watched : shaders_) {
+		if (watched.rebuild && !watched.rebuild->isPending())
+			finishRebuild(watched);
+		// a program still on its first build gets picked up once that is done
+		if (watched.dirty && !watched.rebuild && !watched.shader->isPending()) {
+			watched.dirty = false;
+			const Shader& shader = *watched.shader;
+			watched.rebuild.reset(new Shader(shader.getVertexPath().c_str(), shader.getFragPath().c_str(),
+				shader.getDefines(), true));
+			batch_.add(*watched.rebuild);
+			rebuilding_++;
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file_watcher.h"
+#include "shader.h"
+#include "shader_batch.h"
+#include "texture.h"
+
+// Rebuilds programs and textures whose files change while the renderer keeps
+// running. A changed program compiles again deferred in the ShaderBatch and
+// takes over from the old one only if it links, a changed texture decodes
+// on the pool and overwrites the old image only if it decodes; either way a
+// broken file leaves the last good version on screen.
+// The watched Shaders and textures must outlive this object.
+class HotReload
+{
+public:
+	struct Stats
+	{
+		unsigned int shaderReloads;
+		unsigned int shaderFailures;
+		unsigned int textureReloads;
+	};
+
+	HotReload(ShaderBatch& batch, TextureLoader& textures);
+	~HotReload();
+
+	HotReload(const HotReload&) = delete;
+	HotReload& operator=(const HotReload&) = delete;
+
+	// onReload runs on the GL thread after the new program took over, to set
+	// sampler units, block bindings and cached locations again. Watching the
+	// same Shader twice keeps the first callback.
+	void watchShader(Shader& shader, std::function<void(Shader&)> onReload);
+	void watchTexture(const char* path, unsigned int texture);
+	// GL thread, once per frame
+	void update();
+
+	const Stats& getStats() const { return stats_; }
+
+private:
+	struct WatchedShader
+	{
+		Shader* shader;
+		std::function<void(Shader&)> onReload;
+		// the rebuild in flight, the old program keeps drawing meanwhile
+		std::unique_ptr<Shader> rebuild;
+		// changed again while busy, build once more afterwards
+		bool dirty;
+	};
+	struct WatchedTexture
+	{
+		std::string path;
+		unsigned int texture;
+	};
+
+	void finishRebuild(WatchedShader& watched);
+
+	ShaderBatch& batch_;
+	TextureLoader& textures_;
+	FileWatcher watcher_;
+	std::vector<WatchedShader> shaders_;
+	std::vector<WatchedTexture> textureFiles_;
+	std::vector<std::string> changed_;
+	size_t rebuilding_;
+	Stats stats_;
+};
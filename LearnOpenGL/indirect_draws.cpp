@@ -0,0 +1,177 @@
+#include "indirect_draws.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+
+#define CULL_SHADER_PATH "shaders/cull_indirect.comp"
+
+// compile and link the compute program, 0 on failure
+static GLuint buildComputeProgram(const char* path, bool compact)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return 0;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	std::string code = stream.str();
+	// defines go right after the #version line
+	if (compact)
+	{
+		size_t lineEnd = code.find('\n');
+		code.insert(lineEnd == std::string::npos ? code.size() : lineEnd + 1, "#define COMPACT_COMMANDS\n");
+	}
+
+	const char* source = code.c_str();
+	GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+	GLint success = 0;
+	char infoLog[1024];
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
+		std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: COMPUTE\n" << infoLog << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(program, sizeof(infoLog), nullptr, infoLog);
+		std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: COMPUTE\n" << infoLog << std::endl;
+		GLState::deleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+bool IndirectDraws::isSupported()
+{
+	return GLExt::hasComputeShader && GLExt::hasMultiDrawIndirect;
+}
+
+IndirectDraws::IndirectDraws(const Mesh& mesh)
+	: mesh_(mesh),
+	  compact_(GLExt::hasIndirectParameters),
+	  objectCount_(0),
+	  capacity_(0)
+{
+	program_ = buildComputeProgram(CULL_SHADER_PATH, compact_);
+	planesLoc_ = program_ ? glGetUniformLocation(program_, "planes") : -1;
+	objectCountLoc_ = program_ ? glGetUniformLocation(program_, "objectCount") : -1;
+	indexCountLoc_ = program_ ? glGetUniformLocation(program_, "indexCount") : -1;
+	firstIndexLoc_ = program_ ? glGetUniformLocation(program_, "firstIndex") : -1;
+	baseVertexLoc_ = program_ ? glGetUniformLocation(program_, "baseVertex") : -1;
+
+	glGenBuffers(1, &boundsBuffer_);
+	glGenBuffers(1, &commandBuffer_);
+	glGenBuffers(1, &drawCountBuffer_);
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawCountBuffer_);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+IndirectDraws::~IndirectDraws()
+{
+	if (program_)
+		GLState::deleteProgram(program_);
+	glDeleteBuffers(1, &boundsBuffer_);
+	glDeleteBuffers(1, &commandBuffer_);
+	glDeleteBuffers(1, &drawCountBuffer_);
+}
+
+void IndirectDraws::setBounds(const BoundingSpheres& bounds)
+{
+	objectCount_ = bounds.count;
+	if (objectCount_ > capacity_)
+	{
+		capacity_ = objectCount_;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer_);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity_ * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer_);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity_ * sizeof(glm::vec4), nullptr, GL_STATIC_DRAW);
+	}
+	if (objectCount_ == 0)
+		return;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer_);
+	glm::vec4* spheres = (glm::vec4*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, objectCount_ * sizeof(glm::vec4),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (spheres)
+	{
+		for (size_t i = 0; i < objectCount_; i++)
+			spheres[i] = glm::vec4(bounds.x[i], bounds.y[i], bounds.z[i], bounds.radius[i]);
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void IndirectDraws::cull(const Frustum& frustum)
+{
+	if (!program_ || objectCount_ == 0)
+		return;
+	GLState::useProgram(program_);
+	glUniform4fv(planesLoc_, 6, &frustum.planes[0].x);
+	glUniform1ui(objectCountLoc_, (GLuint)objectCount_);
+	glUniform1ui(indexCountLoc_, (GLuint)mesh_.getIndexCount());
+	// read every cull, the arena may have moved the mesh
+	glUniform1ui(firstIndexLoc_, mesh_.getFirstIndex());
+	glUniform1i(baseVertexLoc_, mesh_.getBaseVertex());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_BOUNDS_BINDING, boundsBuffer_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_COMMANDS_BINDING, commandBuffer_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_DRAW_COUNT_BINDING, drawCountBuffer_);
+	if (compact_)
+	{
+		GLuint zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawCountBuffer_);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	GLExt::dispatchCompute((GLuint)((objectCount_ + INDIRECT_GROUP_SIZE - 1) / INDIRECT_GROUP_SIZE), 1, 1);
+	// the commands and the count are read as draw parameters next
+	GLExt::memoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void IndirectDraws::draw(unsigned int vao) const
+{
+	if (!program_ || objectCount_ == 0)
+		return;
+	GLState::bindVertexArray(vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer_);
+	if (compact_)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, drawCountBuffer_);
+		GLExt::multiDrawElementsIndirectCount(GL_TRIANGLES, mesh_.getIndexType(), (void*)0, 0, (GLsizei)objectCount_, 0);
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+	}
+	else
+	{
+		GLExt::multiDrawElementsIndirect(GL_TRIANGLES, mesh_.getIndexType(), (void*)0, (GLsizei)objectCount_, 0);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+size_t IndirectDraws::readDrawCount() const
+{
+	if (!compact_ || !program_ || objectCount_ == 0)
+		return 0;
+	GLExt::memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	GLuint count = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawCountBuffer_);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return count;
+}
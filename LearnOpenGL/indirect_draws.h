@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include "culling.h"
+#include "mesh.h"
+
+// storage buffer bindings of shaders/cull_indirect.comp
+#define INDIRECT_BOUNDS_BINDING 0
+#define INDIRECT_COMMANDS_BINDING 1
+#define INDIRECT_DRAW_COUNT_BINDING 2
+// invocations per work group, local_size_x of the compute shader
+#define INDIRECT_GROUP_SIZE 64
+
+// layout of one glMultiDrawElementsIndirect command
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// GPU-driven drawing of many instances of one mesh. The bounding spheres
+// live in a storage buffer; every frame a compute shader tests them against
+// the frustum and writes one draw command per object, whose baseInstance
+// picks the object's entry in the unchanged instance buffer. A single
+// glMultiDrawElementsIndirect then draws them, so the CPU cost per frame does
+// not depend on the object count. With ARB_indirect_parameters the visible
+// commands are packed and their count read by the GPU; without it every object
+// keeps a command and the hidden ones draw zero instances.
+// Needs GLExt::hasComputeShader and GLExt::hasMultiDrawIndirect.
+class IndirectDraws
+{
+public:
+	explicit IndirectDraws(const Mesh& mesh);
+	~IndirectDraws();
+
+	IndirectDraws(const IndirectDraws&) = delete;
+	IndirectDraws& operator=(const IndirectDraws&) = delete;
+
+	static bool isSupported();
+	// the compute program compiled and linked
+	bool isValid() const { return program_ != 0; }
+	bool isCompacting() const { return compact_; }
+
+	// object i is instance i of the instance buffer the vao reads
+	void setBounds(const BoundingSpheres& bounds);
+	// cull on the GPU and write the commands, call before draw()
+	void cull(const Frustum& frustum);
+	// the vao must come from Mesh::setupAttributes with the instance buffer attached
+	void draw(unsigned int vao) const;
+
+	size_t getObjectCount() const { return objectCount_; }
+	// visible objects of the last cull(), reads the GPU result back and so
+	// waits for it; only known when compacting
+	size_t readDrawCount() const;
+
+private:
+	const Mesh& mesh_;
+	bool compact_;
+	GLuint program_;
+	GLint planesLoc_;
+	GLint objectCountLoc_;
+	GLint indexCountLoc_;
+	GLint firstIndexLoc_;
+	GLint baseVertexLoc_;
+	GLuint boundsBuffer_;
+	GLuint commandBuffer_;
+	GLuint drawCountBuffer_;
+	size_t objectCount_;
+	size_t capacity_;
+};
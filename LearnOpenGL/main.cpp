@@ -1,29 +1,42 @@
 ﻿#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <assimp/Base64.hpp>
 
-#include "data.h"
-#include "shader.h"
 #include "camera.h"
-
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "camera_path.h"
+#include "context.h"
+#include "gl_state.h"
+#include "scene.h"
+#include "software_renderer.h"
 
 float deltaTime = 0.0f; // 当前帧与上一帧的时间差
 float lastFrame = 0.0f; // 上一帧的时间
 
+const int SCR_WIDTH = 1920;
+const int SCR_HEIGHT = 1080;
+
 float lastX = 810.0f;
 float lastY = 540.0f;
 bool firstMouse = true;
 Camera cam = Camera(glm::vec3(0.0f, 0.0f, -3.0f));
+Scene* scene = nullptr;
+// live input goes to the recorder as well; during a replay it is ignored
+CameraRecorder* recorder = nullptr;
+CameraPlayer* player = nullptr;
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
 	glViewport(0, 0, width, height);
+	if (scene && width > 0 && height > 0)
+		scene->resize(width, height);
 }
 
 void mouseCallBack(GLFWwindow* window, double xpos, double ypos) {
+	if (player)
+		return;
 	if (firstMouse) {
 		lastX = xpos;
 		lastY = ypos;
@@ -35,265 +48,321 @@ void mouseCallBack(GLFWwindow* window, double xpos, double ypos) {
 	lastY = ypos;
 
 	cam.rotate(offsetX, offsetY);
+	if (recorder)
+		recorder->rotate(offsetX, offsetY);
 }
 
 void scrollCallBack(GLFWwindow* window, double xoffset, double yoffset) {
+	if (player)
+		return;
 	cam.zoom(yoffset);
+	if (recorder)
+		recorder->zoom((float)yoffset);
+}
+
+// the cursor is captured, so clicks pick whatever is under the crosshair at the screen center
+void mouseButtonCallBack(GLFWwindow* window, int button, int action, int mods) {
+	if (!scene || button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS)
+		return;
+	BvhHit hit;
+	if (scene->pickBox(cam, 0.0f, 0.0f, hit))
+		std::cout << "Picked box " << hit.index << " at " << hit.distance << std::endl;
+}
+
+static void moveCamera(MoveDirection dir) {
+	cam.translate(dir, deltaTime);
+	if (recorder)
+		recorder->translate(dir, deltaTime);
 }
 
 void processInput(GLFWwindow *window) {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwTerminate();
+	if (player)
+		return;
 	float camSpeed = 2.5f * deltaTime; // adjust accordingly
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		cam.translate(FORWARD, deltaTime);
+		moveCamera(FORWARD);
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		cam.translate(BACKWORD, deltaTime);
+		moveCamera(BACKWORD);
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		cam.translate(LEFT, deltaTime);
+		moveCamera(LEFT);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		cam.translate(RIGHT, deltaTime);
+		moveCamera(RIGHT);
 	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		cam.translate(UP, deltaTime);
+		moveCamera(UP);
 	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-		cam.translate(DOWN, deltaTime);
+		moveCamera(DOWN);
 }
 
-static GLFWwindow* init() {
-	// initailize glfw
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	GLFWwindow* window = glfwCreateWindow(1920, 1080, "LearnOpenGL", NULL, NULL);
-	if (window == nullptr) {
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return nullptr;
+// comma separated: dir, point, spot, emission
+static unsigned int parseFeatures(const char* list) {
+	static const struct { const char* name; unsigned int feature; } names[] = {
+		{ "dir", FEATURE_DIR_LIGHT },
+		{ "point", FEATURE_POINT_LIGHTS },
+		{ "spot", FEATURE_SPOT_LIGHT },
+		{ "emission", FEATURE_EMISSION },
+	};
+	unsigned int features = 0;
+	while (*list) {
+		size_t length = strcspn(list, ",");
+		bool known = false;
+		for (const auto& entry : names) {
+			if (strlen(entry.name) == length && strncmp(entry.name, list, length) == 0) {
+				features |= entry.feature;
+				known = true;
+			}
+		}
+		if (!known)
+			std::cout << "Unknown feature: " << std::string(list, length) << std::endl;
+		list += length;
+		if (*list == ',')
+			list++;
 	}
+	return features;
+}
 
-	glfwMakeContextCurrent(window);
-
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
-		return nullptr;
+static bool init(RenderContext &context, ContextBackend backend) {
+	if (!context.init(backend, SCR_WIDTH, SCR_HEIGHT))
+		return false;
+	GLFWwindow* window = context.getWindow();
+	if (window) {
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		glfwSetCursorPosCallback(window, mouseCallBack);
+		glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+		glfwSetScrollCallback(window, scrollCallBack);
+		glfwSetMouseButtonCallback(window, mouseButtonCallBack);
 	}
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-	glfwSetCursorPosCallback(window, mouseCallBack);
-	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
-	glfwSetScrollCallback(window, scrollCallBack);
-	glEnable(GL_DEPTH_TEST);
-	return window;
+	GLState::enable(GL_DEPTH_TEST);
+	return true;
 }
 
-unsigned int loadTexture(char const * path)
+// no window and no GL at all, the frames come from SoftwareRenderer on every core
+static int runSoftware(int maxFrames, const char* dumpPrefix, unsigned int features)
 {
-	unsigned int textureId;
-	glGenTextures(1, &textureId);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureId);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+	ThreadPool pool;
+	SoftwareRenderer renderer(SCR_WIDTH, SCR_HEIGHT, pool, features);
+	std::cout << "Software renderer: " << pool.getWorkerCount() + 1 << " threads, "
+		<< SOFT_TILE_SIZE << "x" << SOFT_TILE_SIZE << " tiles" << std::endl;
+	double setupMs = 0.0, rasterMs = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < maxFrames; frame++) {
+		if (player)
+			player->step(cam);
+		renderer.render(cam);
+		setupMs += renderer.getStats().setupMs;
+		rasterMs += renderer.getStats().rasterMs;
+		if (dumpPrefix) {
+			char path[512];
+			snprintf(path, sizeof(path), "%s_%04d.ppm", dumpPrefix, frame);
+			renderer.saveFrame(path);
+		}
 	}
-
-	return textureId;
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const SoftwareRenderer::Stats &stats = renderer.getStats();
+	std::cout << maxFrames << " frames in " << elapsed << " s, " << maxFrames / elapsed << " fps; per frame setup "
+		<< setupMs / maxFrames << " ms, raster and shading " << rasterMs / maxFrames << " ms" << std::endl;
+	std::cout << "Last frame: " << stats.triangles << " triangles, " << stats.culled << " culled, "
+		<< stats.binned << " tile bins, " << stats.shadedPixels << " pixels shaded" << std::endl;
+	return 0;
 }
 
-int main()
+// --headless            render through surfaceless EGL into an offscreen FBO
+// --software            render on the CPU without any GL driver, implies no window
+// --frames <n>          stop after n frames (headless and software default to 300)
+// --dump <prefix>       write every frame to <prefix>_0000.ppm, <prefix>_0001.ppm, ...
+// --features <list>     box lighting features, e.g. dir,point,spot,emission (default dir,point,spot)
+// --watch               reload shaders and textures when their files change, always on with a window
+// --profile <prefix>    time frame sections on CPU and GPU, print p50/p95/p99 and write <prefix>.json (chrome://tracing)
+// --record <file>       save every camera input with its timestamp to file on exit
+// --replay <file>       drive the camera from a recorded file at a fixed timestep, ignoring input;
+//                       runs as many frames as the recording covers unless --frames is given
+// --timestep <seconds>  replay timestep (default 1/60)
+// --occlusion           also cull boxes hidden behind the nearest boxes, print how many per frame
+// --gpu-driven          cull on the GPU and draw with multi-draw indirect (GL 4.3), overrides --occlusion
+// --queue-stats         print the render queue's draws and state changes per frame
+int main(int argc, char** argv)
 {
-	GLFWwindow* window = init();
-
-#pragma region Compile Shaders
-	Shader shaderBox = Shader("shaders/shader_box.vs", "shaders/shader_box.fs");
-	Shader shaderLight = Shader("shaders/shader_light.vs", "shaders/shader_light.fs");
-#pragma endregion
-
-#pragma region BuffersSetting
-	unsigned int vbo, cubeVao;
-	glGenVertexArrays(1, &cubeVao);
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-	
-	glBindVertexArray(cubeVao);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	ContextBackend backend = BACKEND_WINDOW;
+	bool software = false;
+	int maxFrames = 0;
+	const char* dumpPrefix = nullptr;
+	unsigned int features = FEATURE_DEFAULT;
+	bool watch = false;
+	const char* profilePrefix = nullptr;
+	const char* recordPath = nullptr;
+	const char* replayPath = nullptr;
+	float timestep = 1.0f / 60.0f;
+	bool occlusion = false;
+	bool gpuDriven = false;
+	bool queueStats = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0)
+			backend = BACKEND_HEADLESS;
+		else if (strcmp(argv[i], "--software") == 0)
+			software = true;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			maxFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+			dumpPrefix = argv[++i];
+		else if (strcmp(argv[i], "--features") == 0 && i + 1 < argc)
+			features = parseFeatures(argv[++i]);
+		else if (strcmp(argv[i], "--watch") == 0)
+			watch = true;
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+			profilePrefix = argv[++i];
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (strcmp(argv[i], "--timestep") == 0 && i + 1 < argc)
+			timestep = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--occlusion") == 0)
+			occlusion = true;
+		else if (strcmp(argv[i], "--gpu-driven") == 0)
+			gpuDriven = true;
+		else if (strcmp(argv[i], "--queue-stats") == 0)
+			queueStats = true;
+		else
+			std::cout << "Unknown argument: " << argv[i] << std::endl;
+	}
+	CameraPath recorded;
+	if (replayPath) {
+		if (!recorded.load(replayPath))
+			return -1;
+		player = new CameraPlayer(recorded, timestep);
+		cam = player->start();
+		if (maxFrames <= 0)
+			maxFrames = player->getFrameCount();
+	}
+	if (recordPath)
+		recorder = new CameraRecorder(cam);
+	if ((backend == BACKEND_HEADLESS || software) && maxFrames <= 0)
+		maxFrames = 300;
+	if (software) {
+		int result = runSoftware(maxFrames, dumpPrefix, features);
+		delete recorder;
+		delete player;
+		return result;
+	}
 
-	unsigned int lightVao;
-	glGenVertexArrays(1, &lightVao);
-	glBindVertexArray(lightVao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-#pragma endregion
+	RenderContext context;
+	if (!init(context, backend))
+		return -1;
+	GLFWwindow* window = context.getWindow();
+
+	scene = new Scene(SCR_WIDTH, SCR_HEIGHT, features);
+	if (watch || backend == BACKEND_WINDOW)
+		scene->enableHotReload();
+	Profiler* profiler = profilePrefix ? new Profiler() : nullptr;
+	scene->setProfiler(profiler);
+	if (gpuDriven && scene->setGpuDriven(true))
+		occlusion = false;
+	scene->setOcclusionCulling(occlusion);
+	// headless runs are benchmarks and frame dumps, start them with every texture and program in place
+	if (backend == BACKEND_HEADLESS)
+		scene->finishLoading();
 
-#pragma region TextureLoad
-	unsigned int diffuseMap = loadTexture("textures/container_diffuse.png");
-	unsigned int specularMap = loadTexture("textures/container_specular.png");
-	/*unsigned int emissionMap = loadTexture("textures/container_emission.jpg");*/
-#pragma endregion
-	
-	shaderBox.use();
-	shaderBox.setInt("material.diffuse", 0);
-	shaderBox.setInt("material.specular", 1);
-	/*shaderBox.setInt("material.emission", 2);*/
 #pragma region RenderLoop
-	while (!glfwWindowShouldClose(window)) {
-		float currentFrame = glfwGetTime();
+	int frameCount = 0;
+	// occlusion culling totals over all frames
+	size_t frustumBoxes = 0, occludedBoxes = 0, occluders = 0;
+	double occlusionMs = 0.0;
+	// render queue totals over all frames
+	size_t queueDraws = 0, programChanges = 0, materialChanges = 0, vaoChanges = 0;
+	double queueSortMs = 0.0;
+	double loopStart = context.getTime();
+	lastFrame = (float)loopStart;
+	while (!context.shouldClose()) {
+		float currentFrame = (float)context.getTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
-		processInput(window);
-
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		// 光源
-		shaderLight.use();
-		glm::vec3 lightColor = glm::vec3(1.0f);
-		glm::vec3 diffuseColor = lightColor * glm::vec3(0.5f); // 降低影响
-		glm::vec3 ambientColor = diffuseColor * glm::vec3(0.2f); // 很低的影响
-		shaderLight.setVec3("lightColor", lightColor);
-		glm::mat4 view = cam.getViewMat();
-		glm::mat4 project = glm::perspective(glm::radians(cam.getFovY()),
-			(float)1920 / (float)1080, 0.1f, 100.0f);
-		shaderLight.setMat4("view", view);
-		shaderLight.setMat4("project", project);
-		glBindVertexArray(lightVao);
-		for (int i = 0; i < std::size(lightPositions); i++) {
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, lightPositions[i]);
-			model = glm::scale(model, glm::vec3(0.1f));
-			shaderLight.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+		if (player) {
+			// simulated time, the same frames whatever the machine
+			deltaTime = timestep;
+			player->step(cam);
 		}
-
-
-		// 被摄物体
-		shaderBox.use();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, diffuseMap);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, specularMap);
-		//glActiveTexture(GL_TEXTURE2);
-		//glBindTexture(GL_TEXTURE_2D, emissionMap);
-
-		shaderBox.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-		shaderBox.setFloat("material.shininess", 32.0f);
-
-		shaderBox.setVec3("dLight.ambient", 0.01f, 0.01f, 0.01f);
-		shaderBox.setVec3("dLight.diffuse", 0.4f, 0.4f, 0.4f);
-		shaderBox.setVec3("dLight.specular", 0.5f, 0.5f, 0.5f);
-		shaderBox.setVec3("dLight.direction", -0.2f, -1.0f, -0.3f);
-
-		for (int i = 0; i < std::size(lightPositions); i++) {
-			std::string tgt = std::string("pLights[" + std::to_string(i) + "]");
-			shaderBox.setVec3(tgt +".position", lightPositions[i]);
-			shaderBox.setVec3(tgt + ".ambient", 0.05f, 0.05f, 0.05f);
-			shaderBox.setVec3(tgt + ".diffuse", 0.5f, 0.5f, 0.5f);
-			shaderBox.setVec3(tgt + ".specular", 1.0f, 1.0f, 1.0f);
-			shaderBox.setFloat(tgt + ".constant", 1.0f);
-			shaderBox.setFloat(tgt + ".linear", 0.045f);
-			shaderBox.setFloat(tgt + ".quadratic", 0.0075f);
+		if (recorder)
+			recorder->setTime(currentFrame - loopStart);
+		if (window)
+			processInput(window);
+
+		if (profiler)
+			profiler->beginFrame();
+		scene->render(cam);
+		if (occlusion) {
+			const Scene::CullStats &stats = scene->getCullStats();
+			frustumBoxes += stats.visibleBoxes + stats.occludedBoxes;
+			occludedBoxes += stats.occludedBoxes;
+			occluders += stats.occluders;
+			occlusionMs += stats.occlusionMs;
+		}
+		if (queueStats) {
+			const RenderQueue::Stats &stats = scene->getRenderQueue().getStats();
+			queueDraws += stats.items;
+			programChanges += stats.programChanges;
+			materialChanges += stats.materialChanges;
+			vaoChanges += stats.vaoChanges;
+			queueSortMs += stats.sortMs;
 		}
 
-		//shaderBox.setVec3("pLights[0].position", lightPositions[0]);
-		//shaderBox.setVec3("pLights[0].ambient", 0.05f, 0.05f, 0.05f);
-		//shaderBox.setVec3("pLights[0].diffuse", 0.5f, 0.5f, 0.5f);
-		//shaderBox.setVec3("pLights[0].specular", 1.0f, 1.0f, 1.0f);
-		//shaderBox.setFloat("pLights[0].constant", 1.0f);
-		//shaderBox.setFloat("pLights[0].linear", 0.045f);
-		//shaderBox.setFloat("pLights[0].quadratic", 0.0075f);
-
-		/*shaderBox.setVec3("pLights[1].position", lightPositions[1]);
-		shaderBox.setVec3("pLights[1].ambient", 0.2f, 0.2f, 0.2f);
-		shaderBox.setVec3("pLights[1].diffuse", 0.5f, 0.5f, 0.5f);
-		shaderBox.setVec3("pLights[1].specular", 1.0f, 1.0f, 1.0f);
-		shaderBox.setFloat("pLights[1].constant", 1.0f);
-		shaderBox.setFloat("pLights[1].linear", 0.045f);
-		shaderBox.setFloat("pLights[1].quadratic", 0.0075f);
-
-		shaderBox.setVec3("pLights[2].position", lightPositions[2]);
-		shaderBox.setVec3("pLights[2].ambient", 0.2f, 0.2f, 0.2f);
-		shaderBox.setVec3("pLights[2].diffuse", 0.5f, 0.5f, 0.5f);
-		shaderBox.setVec3("pLights[2].specular", 1.0f, 1.0f, 1.0f);
-		shaderBox.setFloat("pLights[2].constant", 1.0f);
-		shaderBox.setFloat("pLights[2].linear", 0.045f);
-		shaderBox.setFloat("pLights[2].quadratic", 0.0075f);
-
-		shaderBox.setVec3("pLights[3].position", lightPositions[3]);
-		shaderBox.setVec3("pLights[3].ambient", 0.2f, 0.2f, 0.2f);
-		shaderBox.setVec3("pLights[3].diffuse", 0.2f, 0.2f, 0.2f);
-		shaderBox.setVec3("pLights[3].specular", 1.0f, 1.0f, 1.0f);
-		shaderBox.setFloat("pLights[3].constant", 1.0f);
-		shaderBox.setFloat("pLights[3].linear", 0.045f);
-		shaderBox.setFloat("pLights[3].quadratic", 0.0075f);*/
-		
-		shaderBox.setVec3("sLight.position", cam.getCamPos());
-		shaderBox.setVec3("sLight.direction", cam.getCamFront());
-		shaderBox.setVec3("sLight.ambient", 0.2f, 0.2f, 0.2f);
-		shaderBox.setVec3("sLight.diffuse", 0.5f, 0.5f, 0.5f);
-		shaderBox.setVec3("sLight.specular", 1.0f, 1.0f, 1.0f);
-		shaderBox.setFloat("sLight.cutoff", glm::cos(glm::radians(12.5f)));
-		shaderBox.setFloat("sLight.outerCutoff", glm::cos(glm::radians(17.5f)));
-		shaderBox.setFloat("sLight.constant", 1.0f);
-		shaderBox.setFloat("sLight.linear", 0.045f);
-		shaderBox.setFloat("sLight.quadratic", 0.0075f);
-
-
-		shaderBox.setVec3("viewPos", cam.getCamPos());
-		shaderBox.setMat4("view", view);
-		shaderBox.setMat4("project", project);
-		glBindVertexArray(cubeVao);
-		for (int i = 0; i < std::size(cubePositions); i++) {
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[i]);
-			model = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
-			shaderBox.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+		if (dumpPrefix) {
+			ProfileScope scope(profiler, "dump");
+			char path[512];
+			snprintf(path, sizeof(path), "%s_%04d.ppm", dumpPrefix, frameCount);
+			context.saveFrame(path);
+		}
+		{
+			ProfileScope scope(profiler, "swap");
+			context.swapBuffers();
+			context.pollEvents();
 		}
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		if (profiler)
+			profiler->endFrame();
+		if (++frameCount == maxFrames)
+			context.requestClose();
 	}
+	if (maxFrames > 0) {
+		glFinish();
+		double elapsed = context.getTime() - loopStart;
+		std::cout << frameCount << " frames in " << elapsed << " s, "
+			<< frameCount / elapsed << " fps" << std::endl;
+	}
+	if (occlusion && frameCount > 0)
+		std::cout << "Occlusion culling: " << occluders / frameCount << " occluders, "
+			<< occludedBoxes / frameCount << " of " << frustumBoxes / frameCount << " boxes in the frustum hidden ("
+			<< (frustumBoxes ? 100.0 * occludedBoxes / frustumBoxes : 0.0) << "%), "
+			<< occlusionMs / frameCount << " ms per frame" << std::endl;
+	if (queueStats && frameCount > 0)
+		std::cout << "Render queue: " << (double)queueDraws / frameCount << " draws, "
+			<< (double)programChanges / frameCount << " program, " << (double)materialChanges / frameCount << " material, "
+			<< (double)vaoChanges / frameCount << " vao changes, sorted in " << queueSortMs / frameCount
+			<< " ms per frame" << std::endl;
 #pragma endregion
 
+	// programs finish compiling while the first frames render, so report once they are all in
+	const Shader::BuildStats &shaders = Shader::buildStats;
+	std::cout << "Shaders: " << shaders.compiled << " compiled in " << shaders.compileMs << " ms, "
+		<< shaders.cacheLoads << " loaded from cache in " << shaders.cacheLoadMs << " ms" << std::endl;
+
+	if (profiler) {
+		profiler->printSummary(std::cout);
+		std::string tracePath = std::string(profilePrefix) + ".json";
+		if (profiler->writeChromeTrace(tracePath.c_str()))
+			std::cout << "Trace written to " << tracePath << std::endl;
+	}
+
+	if (recorder && recorder->getPath().save(recordPath))
+		std::cout << "Recorded " << recorder->getPath().events.size() << " camera events ("
+			<< recorder->getPath().getDuration() << " s) to " << recordPath << std::endl;
+
 #pragma region Clear
-	glDeleteVertexArrays(1, &cubeVao);
-	glDeleteVertexArrays(1, &lightVao);
-	glDeleteBuffers(1, &vbo);
-	glfwTerminate();
+	delete recorder;
+	delete player;
+	delete scene;
+	scene = nullptr;
+	delete profiler;
+	context.terminate();
 #pragma endregion
 	return 0;
 }
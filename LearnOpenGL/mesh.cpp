@@ -0,0 +1,183 @@
+#include "mesh.h"
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+
+const VertexAttribute packedVertexLayout[3] = {
+	{ 0, 3, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, position) },
+	// packed formats always carry four components, the shader reads xyz
+	{ 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, normal) },
+	{ 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, uv) },
+};
+
+// IEEE 754 binary16, round to nearest, overflow to infinity, denormals flushed
+static unsigned short packHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned short sign = (unsigned short)((bits >> 16) & 0x8000);
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFF;
+	if (((bits >> 23) & 0xFF) == 0xFF)
+		return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+	if (exponent <= 0)
+		return sign;
+	mantissa += 0x1000;
+	if (mantissa & 0x800000) {
+		mantissa = 0;
+		exponent++;
+	}
+	if (exponent >= 31)
+		return sign | 0x7C00;
+	return sign | (unsigned short)(exponent << 10) | (unsigned short)(mantissa >> 13);
+}
+
+static int packSnorm(float value, int maxValue)
+{
+	float clamped = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return (int)std::lround(clamped * maxValue);
+}
+
+// x in bits 0-9, y in 10-19, z in 20-29, w left at zero
+static unsigned int packNormal(const glm::vec3& n)
+{
+	unsigned int x = (unsigned int)packSnorm(n.x, 511) & 0x3FF;
+	unsigned int y = (unsigned int)packSnorm(n.y, 511) & 0x3FF;
+	unsigned int z = (unsigned int)packSnorm(n.z, 511) & 0x3FF;
+	return x | (y << 10) | (z << 20);
+}
+
+static unsigned short packUnorm16(float value)
+{
+	float clamped = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	return (unsigned short)std::lround(clamped * 65535.0f);
+}
+
+struct PackedVertexHash
+{
+	size_t operator()(const PackedVertex& v) const
+	{
+		// FNV-1a over the 16 bytes, the struct has no padding
+		const unsigned char* bytes = (const unsigned char*)&v;
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(PackedVertex); i++)
+			hash = (hash ^ bytes[i]) * 16777619u;
+		return hash;
+	}
+};
+
+struct PackedVertexEqual
+{
+	bool operator()(const PackedVertex& a, const PackedVertex& b) const
+	{
+		return memcmp(&a, &b, sizeof(PackedVertex)) == 0;
+	}
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay free of padding");
+
+MeshData buildMesh(const float* interleaved, size_t vertexCount)
+{
+	MeshData mesh;
+	std::unordered_map<PackedVertex, unsigned int, PackedVertexHash, PackedVertexEqual> welded;
+	mesh.indices.reserve(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		const float* v = interleaved + i * 8;
+		PackedVertex packed;
+		packed.position[0] = packHalf(v[0]);
+		packed.position[1] = packHalf(v[1]);
+		packed.position[2] = packHalf(v[2]);
+		packed.position[3] = 0;
+		packed.normal = packNormal(glm::vec3(v[3], v[4], v[5]));
+		packed.uv[0] = packUnorm16(v[6]);
+		packed.uv[1] = packUnorm16(v[7]);
+
+		auto found = welded.find(packed);
+		if (found != welded.end()) {
+			mesh.indices.push_back(found->second);
+			continue;
+		}
+		unsigned int index = (unsigned int)mesh.vertices.size();
+		welded.emplace(packed, index);
+		mesh.vertices.push_back(packed);
+		mesh.indices.push_back(index);
+	}
+	return mesh;
+}
+
+MeshArena::MeshArena(size_t vertexBytes, size_t indexBytes)
+	: vertices_(vertexBytes, sizeof(PackedVertex)),
+	  // a multiple of both index sizes
+	  indices_(indexBytes, sizeof(unsigned int))
+{
+}
+
+void MeshArena::setupAttributes(unsigned int vao, GLuint maxLocation) const
+{
+	GLState::bindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vertices_.getBuffer());
+	for (const VertexAttribute& attribute : packedVertexLayout) {
+		if (attribute.location >= maxLocation)
+			continue;
+		glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized,
+			sizeof(PackedVertex), (void*)attribute.offset);
+		glEnableVertexAttribArray(attribute.location);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_.getBuffer());
+	GLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshArena::defragment()
+{
+	vertices_.defragment();
+	indices_.defragment();
+}
+
+Mesh::Mesh(MeshArena& arena, const MeshData& data)
+	: arena_(arena),
+	  indexCount_((GLsizei)data.indices.size()),
+	  vertexCount_((GLsizei)data.vertices.size())
+{
+	vertices_ = arena_.getVertices().allocate(data.vertices.size() * sizeof(PackedVertex));
+	arena_.getVertices().upload(vertices_, data.vertices.data(), data.vertices.size() * sizeof(PackedVertex));
+
+	// indices are relative to the base vertex, so the mesh's own vertex count decides
+	if (data.vertices.size() <= 0x10000) {
+		indexType_ = GL_UNSIGNED_SHORT;
+		std::vector<unsigned short> shortIndices(data.indices.begin(), data.indices.end());
+		indices_ = arena_.getIndices().allocate(shortIndices.size() * sizeof(unsigned short));
+		arena_.getIndices().upload(indices_, shortIndices.data(), shortIndices.size() * sizeof(unsigned short));
+	}
+	else {
+		indexType_ = GL_UNSIGNED_INT;
+		indices_ = arena_.getIndices().allocate(data.indices.size() * sizeof(unsigned int));
+		arena_.getIndices().upload(indices_, data.indices.data(), data.indices.size() * sizeof(unsigned int));
+	}
+}
+
+Mesh::~Mesh()
+{
+	arena_.getVertices().free(vertices_);
+	arena_.getIndices().free(indices_);
+}
+
+void Mesh::setupAttributes(unsigned int vao, GLuint maxLocation) const
+{
+	arena_.setupAttributes(vao, maxLocation);
+}
+
+void Mesh::drawInstanced(unsigned int vao, GLsizei instances, GLuint baseInstance) const
+{
+	GLState::bindVertexArray(vao);
+	const void* indices = (const void*)(getFirstIndex() * getIndexSize());
+	if (baseInstance)
+		GLExt::drawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, indexCount_, indexType_, indices, instances,
+			getBaseVertex(), baseInstance);
+	else
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount_, indexType_, indices, instances, getBaseVertex());
+}
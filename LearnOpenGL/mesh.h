@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "buffer_arena.h"
+
+// Compact vertex: 16 bytes instead of the 32 of an interleaved float vertex.
+// position: 4 half floats (w is padding), normal: GL_INT_2_10_10_10_REV,
+// uv: normalized unsigned shorts, so texture coordinates must lie in [0, 1].
+struct PackedVertex
+{
+	unsigned short position[4];
+	unsigned int normal;
+	unsigned short uv[2];
+};
+
+// one vertex attribute of a packed buffer, consumed by Mesh::setupAttributes
+struct VertexAttribute
+{
+	GLuint location;
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	size_t offset;
+};
+
+// layout of PackedVertex at the locations shader_box.vs reads
+extern const VertexAttribute packedVertexLayout[3];
+
+struct MeshData
+{
+	std::vector<PackedVertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// Packs interleaved position(3) normal(3) uv(2) float vertices and welds the
+// ones that are identical after packing into a shared index buffer.
+MeshData buildMesh(const float* interleaved, size_t vertexCount);
+
+// starting sizes of the MeshArena buffers, they grow when full
+#define MESH_ARENA_VERTEX_BYTES (1 << 20)
+#define MESH_ARENA_INDEX_BYTES (1 << 19)
+
+// Shared vertex and index buffers that meshes sub-allocate from. One vao set
+// up here draws every mesh of the arena, each through its own base vertex
+// and first index, so switching meshes needs no vao or buffer change.
+// Requires a current GL context for its whole lifetime.
+class MeshArena
+{
+public:
+	MeshArena(size_t vertexBytes = MESH_ARENA_VERTEX_BYTES, size_t indexBytes = MESH_ARENA_INDEX_BYTES);
+
+	// point the vao at the arena, only attributes with location < maxLocation
+	// are enabled; stays valid through defragment() and growth
+	void setupAttributes(unsigned int vao, GLuint maxLocation) const;
+	// pack the meshes in both buffers, their offsets change
+	void defragment();
+
+	BufferArena& getVertices() { return vertices_; }
+	BufferArena& getIndices() { return indices_; }
+	const BufferArena& getVertices() const { return vertices_; }
+	const BufferArena& getIndices() const { return indices_; }
+
+private:
+	BufferArena vertices_;
+	BufferArena indices_;
+};
+
+// GPU side of a MeshData: a vertex range and an index range of a MeshArena,
+// indices are stored as unsigned shorts when the vertex count allows it.
+// The arena must outlive the mesh.
+class Mesh
+{
+public:
+	Mesh(MeshArena& arena, const MeshData& data);
+	~Mesh();
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	// the arena's setupAttributes, any mesh of the arena draws through the vao
+	void setupAttributes(unsigned int vao, GLuint maxLocation) const;
+	// the vao must come from setupAttributes; a nonzero baseInstance needs
+	// GLExt::hasBaseInstance
+	void drawInstanced(unsigned int vao, GLsizei instances, GLuint baseInstance = 0) const;
+
+	GLsizei getIndexCount() const { return indexCount_; }
+	GLenum getIndexType() const { return indexType_; }
+	GLsizei getVertexCount() const { return vertexCount_; }
+	size_t getVertexBytes() const { return vertexCount_ * sizeof(PackedVertex); }
+	size_t getIndexBytes() const { return indexCount_ * getIndexSize(); }
+	size_t getIndexSize() const { return indexType_ == GL_UNSIGNED_SHORT ? 2 : 4; }
+	// where the mesh sits in the arena now, look them up for every draw
+	GLuint getFirstIndex() const { return (GLuint)(arena_.getIndices().getOffset(indices_) / getIndexSize()); }
+	GLint getBaseVertex() const { return (GLint)(arena_.getVertices().getOffset(vertices_) / sizeof(PackedVertex)); }
+
+private:
+	MeshArena& arena_;
+	ArenaHandle vertices_;
+	ArenaHandle indices_;
+	GLenum indexType_;
+	GLsizei indexCount_;
+	GLsizei vertexCount_;
+};
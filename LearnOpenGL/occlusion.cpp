@@ -0,0 +1,363 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+// corner i of the cube is at -0.5 or 0.5 on x, y and z by bits 0, 1 and 2;
+// every face counter-clockwise seen from outside
+static const int cubeFaces[6][4] = {
+	{ 1, 3, 7, 5 }, { 0, 4, 6, 2 },
+	{ 2, 6, 7, 3 }, { 0, 1, 5, 4 },
+	{ 4, 5, 7, 6 }, { 0, 2, 3, 1 },
+};
+
+typedef std::chrono::high_resolution_clock OcclusionClock;
+
+static double msSince(OcclusionClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(OcclusionClock::now() - start).count();
+}
+
+// the cube corners in pixel coordinates and 1/w; false if any is closer than OCCLUSION_NEAR
+static bool projectCube(const glm::mat4& mvp, int width, int height, glm::vec2 screen[8], float invW[8])
+{
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 corner((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f, 1.0f);
+		glm::vec4 clip = mvp * corner;
+		if (clip.w < OCCLUSION_NEAR)
+			return false;
+		invW[i] = 1.0f / clip.w;
+		screen[i] = glm::vec2((clip.x * invW[i] * 0.5f + 0.5f) * width, (clip.y * invW[i] * 0.5f + 0.5f) * height);
+	}
+	return true;
+}
+
+static float cross2(const glm::vec2& o, const glm::vec2& a, const glm::vec2& b)
+{
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+OcclusionBuffer::OcclusionBuffer(ThreadPool& pool)
+	: pool_(pool),
+	  width_(0),
+	  height_(0),
+	  tilesX_(0),
+	  tilesY_(0),
+	  viewProject_(1.0f),
+	  stats_()
+{
+	occluders_.reserve(OCCLUSION_MAX_OCCLUDERS);
+}
+
+void OcclusionBuffer::resize(int screenWidth, int screenHeight)
+{
+	width_ = OCCLUSION_WIDTH;
+	tilesX_ = width_ / OCCLUSION_TILE;
+	float height = (float)OCCLUSION_WIDTH * screenHeight / screenWidth;
+	tilesY_ = std::max(1, (int)std::lround(height / OCCLUSION_TILE));
+	height_ = tilesY_ * OCCLUSION_TILE;
+	depth_.assign((size_t)width_ * height_, 0.0f);
+	tiles_.assign((size_t)tilesX_ * tilesY_, 0.0f);
+}
+
+void OcclusionBuffer::render(const glm::mat4& viewProject, const glm::vec3& eye, const InstanceData* instances,
+	const BoundingSpheres& bounds, const unsigned int* candidates, size_t count)
+{
+	auto start = OcclusionClock::now();
+	viewProject_ = viewProject;
+
+	// the biggest looking spheres, smallest of them on top of the heap
+	std::pair<float, unsigned int> picked[OCCLUSION_MAX_OCCLUDERS];
+	int pickedCount = 0;
+	auto greater = std::greater<std::pair<float, unsigned int>>();
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int index = candidates[i];
+		glm::vec3 offset = glm::vec3(bounds.x[index], bounds.y[index], bounds.z[index]) - eye;
+		float distance = glm::length(offset);
+		// the eye inside the sphere, it would reach past the near limit anyway
+		if (distance <= bounds.radius[index])
+			continue;
+		std::pair<float, unsigned int> candidate(bounds.radius[index] / distance, index);
+		if (pickedCount < OCCLUSION_MAX_OCCLUDERS)
+		{
+			picked[pickedCount++] = candidate;
+			std::push_heap(picked, picked + pickedCount, greater);
+		}
+		else if (candidate.first > picked[0].first)
+		{
+			std::pop_heap(picked, picked + pickedCount, greater);
+			picked[pickedCount - 1] = candidate;
+			std::push_heap(picked, picked + pickedCount, greater);
+		}
+	}
+
+	occluders_.clear();
+	for (int i = 0; i < pickedCount; i++)
+	{
+		Occluder occluder;
+		if (setupOccluder(instances[picked[i].second].model, occluder))
+			occluders_.push_back(occluder);
+	}
+	pool_.parallelFor((size_t)tilesY_, 1, [this](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++)
+			rasterBand((int)row);
+	});
+
+	stats_.occluders = occluders_.size();
+	stats_.tested = 0;
+	stats_.occluded = 0;
+	stats_.rasterMs = msSince(start);
+	stats_.testMs = 0.0;
+}
+
+// For a convex cube the surface a pixel sees is on the front face plane that
+// is farthest along the view ray, so its 1/w is the smallest of the front face
+// planes there, and the outline is the convex hull of the projected corners.
+bool OcclusionBuffer::setupOccluder(const glm::mat4& model, Occluder& occluder) const
+{
+	glm::vec2 screen[8];
+	float invW[8];
+	if (!projectCube(viewProject_ * model, width_, height_, screen, invW))
+		return false;
+
+	// a mirroring model turns the faces clockwise
+	glm::vec3 x(model[0]), y(model[1]), z(model[2]);
+	float facing = glm::dot(glm::cross(x, y), z) < 0.0f ? -1.0f : 1.0f;
+	int planes = 0;
+	for (const int* face : cubeFaces)
+	{
+		const glm::vec2 &p0 = screen[face[0]], &p1 = screen[face[1]], &p2 = screen[face[2]];
+		float area = cross2(p0, p1, p2) * facing;
+		// back facing, or seen edge on and covering nothing
+		if (area <= 1.0e-6f)
+			continue;
+		float z0 = invW[face[0]], z1 = invW[face[1]], z2 = invW[face[2]];
+		float d = cross2(p0, p1, p2);
+		float a = ((z1 - z0) * (p2.y - p0.y) - (z2 - z0) * (p1.y - p0.y)) / d;
+		float b = ((p1.x - p0.x) * (z2 - z0) - (p2.x - p0.x) * (z1 - z0)) / d;
+		occluder.depthA[planes] = a;
+		occluder.depthB[planes] = b;
+		// at a pixel center, the lowest value anywhere in the pixel
+		occluder.depthC[planes] = z0 - a * p0.x - b * p0.y - 0.5f * (std::fabs(a) + std::fabs(b));
+		planes++;
+	}
+	if (planes == 0)
+		return false;
+	for (int i = planes; i < 3; i++)
+	{
+		occluder.depthA[i] = occluder.depthA[0];
+		occluder.depthB[i] = occluder.depthB[0];
+		occluder.depthC[i] = occluder.depthC[0];
+	}
+
+	// monotone chain, counter-clockwise without collinear points
+	glm::vec2 sorted[8];
+	std::copy(screen, screen + 8, sorted);
+	std::sort(sorted, sorted + 8, [](const glm::vec2& a, const glm::vec2& b) {
+		return a.x < b.x || (a.x == b.x && a.y < b.y);
+	});
+	glm::vec2 hull[16];
+	int n = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		while (n >= 2 && cross2(hull[n - 2], hull[n - 1], sorted[i]) <= 0.0f)
+			n--;
+		hull[n++] = sorted[i];
+	}
+	for (int i = 6, lower = n + 1; i >= 0; i--)
+	{
+		while (n >= lower && cross2(hull[n - 2], hull[n - 1], sorted[i]) <= 0.0f)
+			n--;
+		hull[n++] = sorted[i];
+	}
+	// the last point closes the loop
+	n--;
+	if (n < 3 || n > 8)
+		return false;
+
+	float lowX = hull[0].x, lowY = hull[0].y, highX = hull[0].x, highY = hull[0].y;
+	for (int i = 0; i < 8; i++)
+	{
+		if (i >= n)
+		{
+			occluder.edgeA[i] = 0.0f;
+			occluder.edgeB[i] = 0.0f;
+			occluder.edgeC[i] = 1.0f;
+			continue;
+		}
+		const glm::vec2 &p0 = hull[i], &p1 = hull[(i + 1) % n];
+		float a = p0.y - p1.y;
+		float b = p1.x - p0.x;
+		occluder.edgeA[i] = a;
+		occluder.edgeB[i] = b;
+		// pixels entirely inside, evaluated at the pixel center
+		occluder.edgeC[i] = -(a * p0.x + b * p0.y) - 0.5f * (std::fabs(a) + std::fabs(b));
+		lowX = std::min(lowX, p0.x);
+		lowY = std::min(lowY, p0.y);
+		highX = std::max(highX, p0.x);
+		highY = std::max(highY, p0.y);
+	}
+	occluder.minX = std::max(0, (int)std::ceil(lowX));
+	occluder.minY = std::max(0, (int)std::ceil(lowY));
+	occluder.maxX = std::min(width_ - 1, (int)std::floor(highX) - 1);
+	occluder.maxY = std::min(height_ - 1, (int)std::floor(highY) - 1);
+	return occluder.minX <= occluder.maxX && occluder.minY <= occluder.maxY;
+}
+
+void OcclusionBuffer::rasterBand(int tileRow)
+{
+	int y0 = tileRow * OCCLUSION_TILE, y1 = y0 + OCCLUSION_TILE;
+	std::fill(depth_.begin() + (size_t)y0 * width_, depth_.begin() + (size_t)y1 * width_, 0.0f);
+
+	for (const Occluder& occluder : occluders_)
+	{
+		int rowBegin = std::max(y0, occluder.minY), rowEnd = std::min(y1 - 1, occluder.maxY);
+		// the rows are a multiple of 4 wide, the last quad never runs over
+		int columnBegin = occluder.minX & ~3;
+		for (int y = rowBegin; y <= rowEnd; y++)
+		{
+			float py = y + 0.5f;
+			float* line = &depth_[(size_t)y * width_];
+#ifdef OCCLUSION_SSE
+			__m128 edgeA[8], edgeRow[8];
+			for (int k = 0; k < 8; k++)
+			{
+				edgeA[k] = _mm_set1_ps(occluder.edgeA[k]);
+				edgeRow[k] = _mm_set1_ps(occluder.edgeB[k] * py + occluder.edgeC[k]);
+			}
+			__m128 depthA[3], depthRow[3];
+			for (int k = 0; k < 3; k++)
+			{
+				depthA[k] = _mm_set1_ps(occluder.depthA[k]);
+				depthRow[k] = _mm_set1_ps(occluder.depthB[k] * py + occluder.depthC[k]);
+			}
+			const __m128 laneX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			const __m128 zero = _mm_setzero_ps();
+			for (int x = columnBegin; x <= occluder.maxX; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneX);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), edgeRow[0]), zero);
+				for (int k = 1; k < 8; k++)
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[k], px), edgeRow[k]), zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthA[0], px), depthRow[0]);
+				z = _mm_min_ps(z, _mm_add_ps(_mm_mul_ps(depthA[1], px), depthRow[1]));
+				z = _mm_min_ps(z, _mm_add_ps(_mm_mul_ps(depthA[2], px), depthRow[2]));
+				// 1/w is never below 0, a masked out lane leaves the stored value
+				_mm_storeu_ps(line + x, _mm_max_ps(_mm_loadu_ps(line + x), _mm_and_ps(inside, z)));
+			}
+#else
+			for (int x = occluder.minX; x <= occluder.maxX; x++)
+			{
+				float px = x + 0.5f;
+				bool inside = true;
+				for (int k = 0; k < 8 && inside; k++)
+					inside = occluder.edgeA[k] * px + occluder.edgeB[k] * py + occluder.edgeC[k] >= 0.0f;
+				if (!inside)
+					continue;
+				float z = occluder.depthA[0] * px + occluder.depthB[0] * py + occluder.depthC[0];
+				for (int k = 1; k < 3; k++)
+					z = std::min(z, occluder.depthA[k] * px + occluder.depthB[k] * py + occluder.depthC[k]);
+				line[x] = std::max(line[x], z);
+			}
+#endif
+		}
+	}
+
+	for (int tx = 0; tx < tilesX_; tx++)
+	{
+		float farthest = depth_[(size_t)y0 * width_ + tx * OCCLUSION_TILE];
+		for (int y = y0; y < y1; y++)
+		{
+			const float* line = &depth_[(size_t)y * width_ + tx * OCCLUSION_TILE];
+			for (int x = 0; x < OCCLUSION_TILE; x++)
+				farthest = std::min(farthest, line[x]);
+		}
+		tiles_[(size_t)tileRow * tilesX_ + tx] = farthest;
+	}
+}
+
+bool OcclusionBuffer::isCubeVisible(const glm::mat4& mvp) const
+{
+	glm::vec2 screen[8];
+	float invW[8];
+	if (!projectCube(mvp, width_, height_, screen, invW))
+		return true;
+	float lowX = screen[0].x, lowY = screen[0].y, highX = screen[0].x, highY = screen[0].y;
+	float nearest = invW[0];
+	for (int i = 1; i < 8; i++)
+	{
+		lowX = std::min(lowX, screen[i].x);
+		lowY = std::min(lowY, screen[i].y);
+		highX = std::max(highX, screen[i].x);
+		highY = std::max(highY, screen[i].y);
+		nearest = std::max(nearest, invW[i]);
+	}
+	// every pixel the projected corners' rectangle touches
+	int x0 = std::max(0, (int)std::floor(lowX)), x1 = std::min(width_ - 1, (int)std::ceil(highX) - 1);
+	int y0 = std::max(0, (int)std::floor(lowY)), y1 = std::min(height_ - 1, (int)std::ceil(highY) - 1);
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	for (int ty = y0 / OCCLUSION_TILE; ty <= y1 / OCCLUSION_TILE; ty++)
+	{
+		for (int tx = x0 / OCCLUSION_TILE; tx <= x1 / OCCLUSION_TILE; tx++)
+		{
+			if (tiles_[(size_t)ty * tilesX_ + tx] > nearest)
+				continue;
+			// some pixel of the tile is farther, maybe not one under the cube
+			int rowBegin = std::max(y0, ty * OCCLUSION_TILE), rowEnd = std::min(y1, ty * OCCLUSION_TILE + OCCLUSION_TILE - 1);
+			int columnBegin = std::max(x0, tx * OCCLUSION_TILE), columnEnd = std::min(x1, tx * OCCLUSION_TILE + OCCLUSION_TILE - 1);
+			for (int y = rowBegin; y <= rowEnd; y++)
+			{
+				const float* line = &depth_[(size_t)y * width_];
+				for (int x = columnBegin; x <= columnEnd; x++)
+				{
+					if (line[x] <= nearest)
+						return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+size_t OcclusionBuffer::cull(const InstanceData* instances, unsigned int* visible, size_t count)
+{
+	if (count == 0)
+		return 0;
+	auto start = OcclusionClock::now();
+	if (hidden_.size() < count)
+		hidden_.resize(count);
+	// two pointers keep the task inside std::function's own storage, no allocation
+	struct Batch
+	{
+		const InstanceData* instances;
+		const unsigned int* visible;
+	} batch = { instances, visible };
+	pool_.parallelFor(count, 256, [this, &batch](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			hidden_[i] = !isCubeVisible(viewProject_ * batch.instances[batch.visible[i]].model);
+	});
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		visible[kept] = visible[i];
+		kept += !hidden_[i];
+	}
+	stats_.tested += count;
+	stats_.occluded += count - kept;
+	stats_.testMs += msSince(start);
+	return kept;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "thread_pool.h"
+#include "transform.h"
+
+// width of the depth buffer in pixels, the height follows the screen aspect
+#define OCCLUSION_WIDTH 256
+// the hierarchical depth keeps the farthest depth of square tiles of this many pixels
+#define OCCLUSION_TILE 8
+// the boxes covering the most of the screen are drawn as occluders, at most this many
+#define OCCLUSION_MAX_OCCLUDERS 32
+// occluders and tested boxes reaching closer to the eye than this are never culled
+#define OCCLUSION_NEAR 0.1f
+
+// Occlusion culling against a small CPU depth buffer, in the spirit of
+// masked software occlusion culling. The boxes that look biggest from the
+// eye are rasterized as occluders: the convex silhouette of each cube,
+// shrunk to the pixels it covers completely, with the depth of its nearest
+// front face plane evaluated where that plane is farthest over the pixel, so
+// the buffer never holds anything closer than the occluders really are.
+// Bands of tile rows rasterize on the thread pool with SSE and reduce to the
+// hierarchical depth; projected cubes are then tested against the tiles and,
+// where a tile is not conclusive, against its pixels. Depth is stored as 1/w,
+// larger is nearer, 0 is empty.
+class OcclusionBuffer
+{
+public:
+	struct Stats
+	{
+		size_t occluders;
+		size_t tested;
+		size_t occluded;
+		double rasterMs;
+		double testMs;
+	};
+
+	explicit OcclusionBuffer(ThreadPool& pool);
+
+	OcclusionBuffer(const OcclusionBuffer&) = delete;
+	OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+
+	// the aspect of the screen being culled for
+	void resize(int screenWidth, int screenHeight);
+
+	// clear and draw the occluders for this frame, picked among the candidate
+	// cubes by bounding sphere size over distance from eye
+	void render(const glm::mat4& viewProject, const glm::vec3& eye, const InstanceData* instances,
+		const BoundingSpheres& bounds, const unsigned int* candidates, size_t count);
+
+	// drop the indices in visible whose -0.5..0.5 cube is hidden behind the
+	// occluders or off screen, keeping the order; returns how many are left
+	size_t cull(const InstanceData* instances, unsigned int* visible, size_t count);
+
+	int getWidth() const { return width_; }
+	int getHeight() const { return height_; }
+	// 1/w per pixel, bottom row first
+	const std::vector<float>& getDepth() const { return depth_; }
+	// occluders of the last render(), tests summed over the cull() calls since
+	const Stats& getStats() const { return stats_; }
+
+private:
+	// the silhouette of one occluder cube in pixel coordinates
+	struct Occluder
+	{
+		// edges a * x + b * y + c, at least 0 where a pixel is covered completely;
+		// a box outline has up to 6, unused ones are always 1
+		float edgeA[8], edgeB[8], edgeC[8];
+		// 1/w of the front faces, planes a * x + b * y + c biased to the far corner of a pixel
+		float depthA[3], depthB[3], depthC[3];
+		int minX, minY, maxX, maxY;
+	};
+
+	bool setupOccluder(const glm::mat4& model, Occluder& occluder) const;
+	void rasterBand(int tileRow);
+	bool isCubeVisible(const glm::mat4& mvp) const;
+
+	ThreadPool& pool_;
+	int width_;
+	int height_;
+	int tilesX_;
+	int tilesY_;
+	glm::mat4 viewProject_;
+	std::vector<float> depth_;
+	// farthest 1/w of every tile
+	std::vector<float> tiles_;
+	std::vector<Occluder> occluders_;
+	// per tested index, written in parallel before the serial compaction
+	std::vector<unsigned char> hidden_;
+	Stats stats_;
+};
@@ -0,0 +1,256 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+Profiler::Profiler(size_t historyFrames)
+	: history_(historyFrames > 0 ? historyFrames : 1), sectionCount_(0), gpuSectionOpen_(false),
+	  frameCount_(0), droppedQueries_(0), epoch_(Clock::now()), frameStart_(epoch_)
+{
+	for (size_t slot = 0; slot < PROFILER_QUERY_FRAMES; slot++)
+		slotFrames_[slot] = 0;
+	samples_.reserve(history_.size());
+	for (FrameRecord& record : history_)
+		record.frame = (size_t)-1;
+}
+
+Profiler::~Profiler()
+{
+	for (int i = 0; i < sectionCount_; i++)
+		if (sections_[i].gpu)
+			glDeleteQueries(PROFILER_QUERY_FRAMES, sections_[i].queries);
+}
+
+double Profiler::msSinceEpoch(Clock::time_point time) const
+{
+	return std::chrono::duration<double, std::milli>(time - epoch_).count();
+}
+
+// string literals usually match by address, strcmp covers the rest
+int Profiler::findSection(const char* name) const
+{
+	for (int i = 0; i < sectionCount_; i++)
+		if (sections_[i].name == name)
+			return i;
+	for (int i = 0; i < sectionCount_; i++)
+		if (strcmp(sections_[i].name, name) == 0)
+			return i;
+	return -1;
+}
+
+int Profiler::findSection(const char* name)
+{
+	int index = ((const Profiler*)this)->findSection(name);
+	if (index >= 0 || sectionCount_ == PROFILER_MAX_SECTIONS)
+		return index;
+	Section& section = sections_[sectionCount_];
+	section.name = name;
+	section.gpu = false;
+	section.queryOpen = false;
+	for (size_t slot = 0; slot < PROFILER_QUERY_FRAMES; slot++)
+		section.issued[slot] = false;
+	return sectionCount_++;
+}
+
+void Profiler::collectQueries(size_t slot, size_t frame)
+{
+	FrameRecord& record = history_[frame % history_.size()];
+	bool recorded = record.frame == frame;
+	for (int i = 0; i < sectionCount_; i++) {
+		Section& section = sections_[i];
+		if (!section.issued[slot])
+			continue;
+		section.issued[slot] = false;
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(section.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			// waiting would stall, the slot is reused right away instead
+			droppedQueries_++;
+			continue;
+		}
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(section.queries[slot], GL_QUERY_RESULT, &ns);
+		if (recorded)
+			record.gpuMs[i] = (float)(ns / 1.0e6);
+	}
+}
+
+void Profiler::beginFrame()
+{
+	size_t slot = frameCount_ % PROFILER_QUERY_FRAMES;
+	collectQueries(slot, slotFrames_[slot]);
+	slotFrames_[slot] = frameCount_;
+
+	frameStart_ = Clock::now();
+	FrameRecord& record = history_[frameCount_ % history_.size()];
+	record.frame = frameCount_;
+	record.startMs = msSinceEpoch(frameStart_);
+	record.frameMs = -1.0;
+	for (int i = 0; i < PROFILER_MAX_SECTIONS; i++)
+		record.cpuStartMs[i] = record.cpuMs[i] = record.gpuMs[i] = -1.0f;
+}
+
+void Profiler::endFrame()
+{
+	history_[frameCount_ % history_.size()].frameMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart_).count();
+	frameCount_++;
+}
+
+void Profiler::beginSection(const char* name, bool gpu)
+{
+	int index = findSection(name);
+	if (index < 0)
+		return;
+	Section& section = sections_[index];
+	size_t slot = frameCount_ % PROFILER_QUERY_FRAMES;
+	// one GPU sample per section and frame, the query of this slot is taken otherwise
+	if (gpu && !gpuSectionOpen_ && !section.issued[slot]) {
+		if (!section.gpu) {
+			glGenQueries(PROFILER_QUERY_FRAMES, section.queries);
+			section.gpu = true;
+		}
+		glBeginQuery(GL_TIME_ELAPSED, section.queries[slot]);
+		section.issued[slot] = true;
+		gpuSectionOpen_ = true;
+		section.queryOpen = true;
+	}
+	section.start = Clock::now();
+}
+
+void Profiler::endSection(const char* name)
+{
+	Clock::time_point end = Clock::now();
+	int index = findSection(name);
+	if (index < 0)
+		return;
+	Section& section = sections_[index];
+	if (section.queryOpen) {
+		glEndQuery(GL_TIME_ELAPSED);
+		section.queryOpen = false;
+		gpuSectionOpen_ = false;
+	}
+	// a section that runs several times per frame adds up, starting at its first run
+	FrameRecord& record = history_[frameCount_ % history_.size()];
+	float ms = (float)std::chrono::duration<double, std::milli>(end - section.start).count();
+	if (record.cpuMs[index] < 0.0f) {
+		record.cpuStartMs[index] = (float)std::chrono::duration<double, std::milli>(section.start - frameStart_).count();
+		record.cpuMs[index] = ms;
+	}
+	else
+		record.cpuMs[index] += ms;
+}
+
+bool Profiler::percentiles(int section, bool gpu, Percentiles& out) const
+{
+	samples_.clear();
+	size_t first = frameCount_ > history_.size() ? frameCount_ - history_.size() : 0;
+	for (size_t frame = first; frame < frameCount_; frame++) {
+		const FrameRecord& record = history_[frame % history_.size()];
+		float value = section < 0 ? (float)record.frameMs : (gpu ? record.gpuMs[section] : record.cpuMs[section]);
+		if (value >= 0.0f)
+			samples_.push_back(value);
+	}
+	if (samples_.empty())
+		return false;
+	std::sort(samples_.begin(), samples_.end());
+	// nearest rank
+	auto rank = [this](double p) {
+		size_t index = (size_t)(p * samples_.size() + 0.999999);
+		return (double)samples_[index > 0 ? index - 1 : 0];
+	};
+	out.p50 = rank(0.50);
+	out.p95 = rank(0.95);
+	out.p99 = rank(0.99);
+	return true;
+}
+
+bool Profiler::getCpuPercentiles(const char* name, Percentiles& out) const
+{
+	int index = findSection(name);
+	return index >= 0 && percentiles(index, false, out);
+}
+
+bool Profiler::getGpuPercentiles(const char* name, Percentiles& out) const
+{
+	int index = findSection(name);
+	return index >= 0 && percentiles(index, true, out);
+}
+
+bool Profiler::getFramePercentiles(Percentiles& out) const
+{
+	return percentiles(-1, false, out);
+}
+
+static void printPercentiles(std::ostream& out, const char* label, const Profiler::Percentiles& p)
+{
+	out << "  " << label << " p50 " << p.p50 << " p95 " << p.p95 << " p99 " << p.p99 << " ms";
+}
+
+void Profiler::printSummary(std::ostream& out) const
+{
+	size_t frames = frameCount_ < history_.size() ? frameCount_ : history_.size();
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+	out << "Profile of the last " << frames << " frames";
+	if (droppedQueries_)
+		out << " (" << droppedQueries_ << " GPU results not ready in time)";
+	out << std::endl;
+	Percentiles p;
+	if (getFramePercentiles(p)) {
+		out << "  " << std::left << std::setw(14) << "frame";
+		printPercentiles(out, "CPU", p);
+		out << std::endl;
+	}
+	for (int i = 0; i < sectionCount_; i++) {
+		out << "  " << std::left << std::setw(14) << sections_[i].name;
+		if (percentiles(i, false, p))
+			printPercentiles(out, "CPU", p);
+		if (percentiles(i, true, p))
+			printPercentiles(out, "GPU", p);
+		out << std::endl;
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
+
+// complete event, trace times are in microseconds
+static void writeTraceEvent(std::ofstream& file, const char* name, int track, double startMs, double durationMs)
+{
+	file << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track
+		<< ",\"ts\":" << startMs * 1000.0 << ",\"dur\":" << durationMs * 1000.0 << "}";
+}
+
+bool Profiler::writeChromeTrace(const char* path) const
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "ERROR::PROFILER::TRACE_WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	file << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}";
+	file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU (GL_TIME_ELAPSED)\"}}";
+	size_t begin = frameCount_ > history_.size() ? frameCount_ - history_.size() : 0;
+	for (size_t frame = begin; frame < frameCount_; frame++) {
+		const FrameRecord& record = history_[frame % history_.size()];
+		if (record.frame != frame || record.frameMs < 0.0)
+			continue;
+		writeTraceEvent(file, "frame", 1, record.startMs, record.frameMs);
+		for (int i = 0; i < sectionCount_; i++) {
+			if (record.cpuMs[i] < 0.0f)
+				continue;
+			double start = record.startMs + record.cpuStartMs[i];
+			writeTraceEvent(file, sections_[i].name, 1, start, record.cpuMs[i]);
+			// the GPU ran it some time after submission, only its duration is known
+			if (record.gpuMs[i] >= 0.0f)
+				writeTraceEvent(file, sections_[i].name, 2, start, record.gpuMs[i]);
+		}
+	}
+	file << "\n]}\n";
+	return (bool)file;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include <glad/glad.h>
+
+// sections a frame can be split into, and frames a GPU result may trail behind
+#define PROFILER_MAX_SECTIONS 16
+#define PROFILER_QUERY_FRAMES 4
+
+// Where frame time goes, on the CPU and on the GPU. Sections are named by
+// string literals and timed with ProfileScope; a section opened with gpu =
+// true also brackets its GL commands with a GL_TIME_ELAPSED query. Queries
+// come from a ring PROFILER_QUERY_FRAMES frames deep and are read back that
+// many frames later, only once the driver reports them available, so timing
+// never stalls the pipeline; a result still missing by then is dropped.
+// GL_TIME_ELAPSED queries cannot nest, GPU sections must not overlap.
+// The last historyFrames frames are kept for percentiles and trace export,
+// all storage is allocated up front so profiling adds no heap traffic.
+class Profiler
+{
+public:
+	struct Percentiles
+	{
+		double p50;
+		double p95;
+		double p99;
+	};
+
+	explicit Profiler(size_t historyFrames = 600);
+	~Profiler();
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	// GL thread, around everything a frame does
+	void beginFrame();
+	void endFrame();
+
+	// name must be a string literal or otherwise outlive the profiler
+	void beginSection(const char* name, bool gpu);
+	void endSection(const char* name);
+
+	// frames recorded so far, including those that rolled out of the history
+	size_t getFrameCount() const { return frameCount_; }
+	// over the frames in the history; false when the section has no samples
+	bool getCpuPercentiles(const char* name, Percentiles& out) const;
+	bool getGpuPercentiles(const char* name, Percentiles& out) const;
+	bool getFramePercentiles(Percentiles& out) const;
+
+	// one line per section with CPU and GPU p50/p95/p99 in ms
+	void printSummary(std::ostream& out) const;
+	// chrome://tracing / Perfetto JSON of the history: CPU sections on one
+	// track, GPU sections on another starting where their CPU section did
+	bool writeChromeTrace(const char* path) const;
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Section
+	{
+		const char* name;
+		bool gpu;
+		// per query frame slot
+		GLuint queries[PROFILER_QUERY_FRAMES];
+		bool issued[PROFILER_QUERY_FRAMES];
+		// this run brackets its commands with a query
+		bool queryOpen;
+		Clock::time_point start;
+	};
+	// times in ms, negative for a section that did not run (or no GPU result yet)
+	struct FrameRecord
+	{
+		size_t frame;
+		double startMs;
+		double frameMs;
+		float cpuStartMs[PROFILER_MAX_SECTIONS];
+		float cpuMs[PROFILER_MAX_SECTIONS];
+		float gpuMs[PROFILER_MAX_SECTIONS];
+	};
+
+	int findSection(const char* name);
+	int findSection(const char* name) const;
+	double msSinceEpoch(Clock::time_point time) const;
+	void collectQueries(size_t slot, size_t frame);
+	bool percentiles(int section, bool gpu, Percentiles& out) const;
+
+	std::vector<FrameRecord> history_;
+	Section sections_[PROFILER_MAX_SECTIONS];
+	int sectionCount_;
+	// frame whose queries each slot holds
+	size_t slotFrames_[PROFILER_QUERY_FRAMES];
+	bool gpuSectionOpen_;
+	size_t frameCount_;
+	size_t droppedQueries_;
+	Clock::time_point epoch_;
+	Clock::time_point frameStart_;
+	// percentile scratch
+	mutable std::vector<float> samples_;
+};
+
+// times the enclosing block; a null profiler makes it a no-op
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler* profiler, const char* name, bool gpu = false)
+		: profiler_(profiler), name_(name)
+	{
+		if (profiler_)
+			profiler_->beginSection(name_, gpu);
+	}
+	~ProfileScope()
+	{
+		if (profiler_)
+			profiler_->endSection(name_);
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	Profiler* profiler_;
+	const char* name_;
+};
@@ -0,0 +1,127 @@
+#include "program_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#define makeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define makeDirectory(path) mkdir(path, 0755)
+#endif
+
+#include "gl_ext.h"
+#include "gl_state.h"
+
+static const char CACHE_MAGIC[8] = { 'L', 'O', 'G', 'L', 'P', 'B', 'I', 'N' };
+
+// file layout: magic, key, binary format, binary length, binary
+struct CacheHeader
+{
+	char magic[8];
+	unsigned long long key;
+	unsigned int format;
+	unsigned int length;
+};
+
+bool ProgramCache::enabled_ = true;
+std::string ProgramCache::directory_ = "shader_cache";
+
+static unsigned long long fnv1a(unsigned long long hash, const char* data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+	return hash;
+}
+
+// the terminating zero separates the fields, so "ab" + "c" and "a" + "bc" differ
+static unsigned long long fnv1a(unsigned long long hash, const char* text)
+{
+	return fnv1a(hash, text ? text : "", (text ? strlen(text) : 0) + 1);
+}
+
+unsigned long long ProgramCache::key(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	hash = fnv1a(hash, vertexCode.c_str(), vertexCode.size() + 1);
+	hash = fnv1a(hash, fragmentCode.c_str(), fragmentCode.size() + 1);
+	hash = fnv1a(hash, (const char*)glGetString(GL_VENDOR));
+	hash = fnv1a(hash, (const char*)glGetString(GL_RENDERER));
+	hash = fnv1a(hash, (const char*)glGetString(GL_VERSION));
+	return hash;
+}
+
+bool ProgramCache::isEnabled()
+{
+	return enabled_ && GLExt::hasProgramBinary;
+}
+
+std::string ProgramCache::pathOf(unsigned long long key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.bin", key);
+	return directory_ + name;
+}
+
+GLuint ProgramCache::load(unsigned long long key)
+{
+	if (!isEnabled())
+		return 0;
+	std::ifstream file(pathOf(key), std::ios::binary);
+	if (!file)
+		return 0;
+	CacheHeader header;
+	if (!file.read((char*)&header, sizeof(header))
+		|| memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.key != key)
+		return 0;
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+		return 0;
+
+	GLuint program = glCreateProgram();
+	GLExt::programBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+	// a driver that changed without changing its strings rejects the binary, the caller compiles instead
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		GLState::deleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+void ProgramCache::prepare(GLuint program)
+{
+	if (isEnabled())
+		GLExt::programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(GLuint program, unsigned long long key)
+{
+	if (!isEnabled())
+		return;
+	GLint linked = GL_FALSE, length = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!linked || length <= 0)
+		return;
+
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.key = key;
+	std::vector<char> binary(length);
+	GLsizei written = 0;
+	GLenum format = 0;
+	GLExt::getProgramBinary(program, length, &written, &format, binary.data());
+	header.format = format;
+	header.length = (unsigned int)written;
+
+	makeDirectory(directory_.c_str());
+	std::ofstream file(pathOf(key), std::ios::binary | std::ios::trunc);
+	if (!file.write((const char*)&header, sizeof(header)) || !file.write(binary.data(), written))
+		std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED " << pathOf(key) << std::endl;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+#include <glad/glad.h>
+
+// On-disk cache of linked program binaries, one file per program in
+// shader_cache/ next to the shaders. The key hashes the GLSL sources together
+// with the GL vendor, renderer and version strings, so a driver update or an
+// edited shader simply misses. Needs GLExt::hasProgramBinary; without it
+// every lookup misses and nothing is written.
+class ProgramCache
+{
+public:
+	static unsigned long long key(const std::string& vertexCode, const std::string& fragmentCode);
+
+	// linked program from the cache, 0 on a miss or when the driver rejects the binary
+	static GLuint load(unsigned long long key);
+	// call before glLinkProgram so the driver keeps a retrievable binary
+	static void prepare(GLuint program);
+	// write the binary of a successfully linked program
+	static void store(GLuint program, unsigned long long key);
+
+	static void setEnabled(bool enabled) { enabled_ = enabled; }
+	static bool isEnabled();
+	static void setDirectory(const char* directory) { directory_ = directory; }
+
+private:
+	static std::string pathOf(unsigned long long key);
+
+	static bool enabled_;
+	static std::string directory_;
+};
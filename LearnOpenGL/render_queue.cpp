@@ -0,0 +1,140 @@
+#include "render_queue.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "gl_state.h"
+
+RenderQueue::RenderQueue()
+	: stats_()
+{
+	for (const char*& name : passNames_)
+		name = nullptr;
+}
+
+uint64_t RenderQueue::depthBits(float depth)
+{
+	float clamped = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+	return (uint64_t)(clamped * (float)((1 << QUEUE_DEPTH_BITS) - 1));
+}
+
+uint64_t RenderQueue::makeKey(unsigned int pass, GLuint program, unsigned int material, GLuint vao, float depth)
+{
+	uint64_t key = pass & ((1u << QUEUE_PASS_BITS) - 1);
+	key = (key << QUEUE_PROGRAM_BITS) | (program & ((1u << QUEUE_PROGRAM_BITS) - 1));
+	key = (key << QUEUE_MATERIAL_BITS) | (material & ((1u << QUEUE_MATERIAL_BITS) - 1));
+	key = (key << QUEUE_VAO_BITS) | (vao & ((1u << QUEUE_VAO_BITS) - 1));
+	return (key << QUEUE_DEPTH_BITS) | depthBits(depth);
+}
+
+void RenderQueue::setPassName(unsigned int pass, const char* name)
+{
+	passNames_[pass & (QUEUE_PASSES - 1)] = name;
+}
+
+void RenderQueue::clear()
+{
+	items_.clear();
+	entries_.clear();
+}
+
+void RenderQueue::submit(uint64_t key, const RenderItem& item)
+{
+	entries_.push_back({ key, (unsigned int)items_.size() });
+	items_.push_back(item);
+}
+
+void RenderQueue::radixSort(SortEntry* entries, SortEntry* scratch, size_t count)
+{
+	if (count == 0)
+		return;
+	// all eight histograms in one read of the keys
+	size_t counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = entries[i].key;
+		for (int digit = 0; digit < 8; digit++)
+			counts[digit][(key >> (digit * 8)) & 0xFF]++;
+	}
+
+	SortEntry* from = entries;
+	SortEntry* to = scratch;
+	for (int digit = 0; digit < 8; digit++)
+	{
+		size_t* histogram = counts[digit];
+		// every key has the same byte here, the order stays as it is
+		if (histogram[(entries[0].key >> (digit * 8)) & 0xFF] == count)
+			continue;
+		size_t offset = 0;
+		for (int value = 0; value < 256; value++)
+		{
+			size_t n = histogram[value];
+			histogram[value] = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < count; i++)
+			to[histogram[(from[i].key >> (digit * 8)) & 0xFF]++] = from[i];
+		SortEntry* swap = from;
+		from = to;
+		to = swap;
+	}
+	if (from != entries)
+		memcpy(entries, from, count * sizeof(SortEntry));
+}
+
+void RenderQueue::execute(Profiler* profiler)
+{
+	stats_ = Stats();
+	stats_.items = items_.size();
+	if (items_.empty())
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if (scratch_.size() < entries_.size())
+		scratch_.resize(entries_.size());
+	radixSort(entries_.data(), scratch_.data(), entries_.size());
+	stats_.sortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	const char* section = nullptr;
+	const RenderItem* previous = nullptr;
+	for (const SortEntry& entry : entries_)
+	{
+		const RenderItem& item = items_[entry.index];
+		const char* name = passNames_[entry.key >> (64 - QUEUE_PASS_BITS)];
+		if (profiler && name != section)
+		{
+			if (section)
+				profiler->endSection(section);
+			if (name)
+				profiler->beginSection(name, true);
+			section = name;
+		}
+
+		if (!previous || item.program != previous->program)
+		{
+			stats_.programChanges++;
+			GLState::useProgram(item.program);
+		}
+		if (!previous || item.material != previous->material)
+		{
+			stats_.materialChanges++;
+			for (int i = 0; item.material && i < item.material->textureCount; i++)
+			{
+				const Material::Binding& binding = item.material->textures[i];
+				GLState::bindTexture(binding.unit, binding.target, binding.texture);
+			}
+		}
+		// the draw binds the vao itself
+		if (!previous || item.vao != previous->vao)
+			stats_.vaoChanges++;
+
+		if (item.indirect)
+			item.indirect->draw(item.vao);
+		else if (item.instances > 0)
+			item.mesh->drawInstanced(item.vao, item.instances, item.baseInstance);
+		previous = &item;
+	}
+	if (section)
+		profiler->endSection(section);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "indirect_draws.h"
+#include "mesh.h"
+#include "profiler.h"
+
+// sort key fields, from the most significant bit down: pass, program,
+// material, vao, depth. Ids wider than their field are folded into it, which
+// only costs sorting quality, never correctness.
+#define QUEUE_PASS_BITS 4
+#define QUEUE_PROGRAM_BITS 12
+#define QUEUE_MATERIAL_BITS 12
+#define QUEUE_VAO_BITS 12
+#define QUEUE_DEPTH_BITS 24
+#define QUEUE_PASSES (1 << QUEUE_PASS_BITS)
+// textures one material binds at most
+#define QUEUE_MATERIAL_TEXTURES 8
+
+// the textures a draw needs; id goes into the sort key, so draws sharing a
+// material run back to back and it is bound once for all of them
+struct Material
+{
+	struct Binding
+	{
+		GLuint unit;
+		GLenum target;
+		GLuint texture;
+	};
+
+	unsigned int id = 0;
+	int textureCount = 0;
+	Binding textures[QUEUE_MATERIAL_TEXTURES];
+
+	void clear() { textureCount = 0; }
+	void add(GLuint unit, GLenum target, GLuint texture)
+	{
+		if (textureCount < QUEUE_MATERIAL_TEXTURES)
+			textures[textureCount++] = { unit, target, texture };
+	}
+};
+
+// one draw and the state it runs with
+struct RenderItem
+{
+	GLuint program;
+	GLuint vao;
+	// null binds nothing
+	const Material* material;
+	// an instanced draw of mesh, or the commands of indirect when that is set
+	const Mesh* mesh;
+	GLsizei instances;
+	GLuint baseInstance;
+	const IndirectDraws* indirect;
+};
+
+// Draws submitted in any order with a 64-bit key, radix sorted and issued
+// once per frame. Sorting by pass, then program, material and vao puts the
+// draws that share state next to each other, so each change happens once;
+// depth comes last, so within the same state opaque draws go front to back
+// and early depth testing rejects what later draws hide. The storage is kept
+// between frames, a steady frame allocates nothing.
+class RenderQueue
+{
+public:
+	struct Stats
+	{
+		size_t items;
+		// between consecutive draws of the sorted queue, the first draw counts
+		unsigned int programChanges;
+		unsigned int materialChanges;
+		unsigned int vaoChanges;
+		double sortMs;
+	};
+
+	struct SortEntry
+	{
+		uint64_t key;
+		unsigned int index;
+	};
+
+	RenderQueue();
+
+	// depth in [0, 1] with 0 nearest, pass 1 - depth to sort back to front
+	static uint64_t makeKey(unsigned int pass, GLuint program, unsigned int material, GLuint vao, float depth);
+	// depth in [0, 1] as the key's depth field
+	static uint64_t depthBits(float depth);
+	// opens a GPU profiler section around the pass, name must be a string literal
+	void setPassName(unsigned int pass, const char* name);
+
+	void clear();
+	void submit(uint64_t key, const RenderItem& item);
+	// sort and draw everything submitted since clear()
+	void execute(Profiler* profiler = nullptr);
+
+	size_t size() const { return items_.size(); }
+	const Stats& getStats() const { return stats_; }
+
+	// stable least significant digit first, one byte per pass, skipping the
+	// bytes all keys share; scratch holds count entries, the result ends in entries
+	static void radixSort(SortEntry* entries, SortEntry* scratch, size_t count);
+
+private:
+	std::vector<RenderItem> items_;
+	std::vector<SortEntry> entries_;
+	std::vector<SortEntry> scratch_;
+	const char* passNames_[QUEUE_PASSES];
+	Stats stats_;
+};
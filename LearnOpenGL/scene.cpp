@@ -0,0 +1,631 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+
+#include "data.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "texture.h"
+
+// per-instance matrices take one vec4/vec3 attribute per column, advancing once per instance
+#define INSTANCE_MODEL_LOCATION 3
+#define INSTANCE_NORMAL_LOCATION 7
+// units 2-4 hold the cluster buffers
+#define EMISSION_TEXTURE_UNIT 5
+// the cube mesh spans -0.5..0.5, its corners are this far from the center
+#define CUBE_BOUND_RADIUS 0.8660254f
+// from this many boxes on the BVH culls them; the flat SIMD sphere test breaks even
+// with the BVH query around a million boxes and does not need the tree built first
+#define BVH_CULL_MIN_BOXES (1 << 20)
+// refits that stretched the tree past this factor of its built cost trigger a rebuild
+#define BVH_REBUILD_COST 2.0f
+
+#define CAMERA_Z_NEAR 0.1f
+#define CAMERA_Z_FAR 100.0f
+
+// render queue passes, in drawing order; each is its own profiler section
+#define SCENE_PASS_LIGHTS 0
+#define SCENE_PASS_BOXES 1
+// render queue material ids, 0 is none
+#define BOX_MATERIAL_ID 1
+#define FALLBACK_MATERIAL_ID 2
+
+// image decodes run beside the frame, a couple of threads keep up with loading
+#define TEXTURE_DECODE_WORKERS 2
+
+#define DIFFUSE_TEXTURE_PATH "textures/container_diffuse.png"
+#define SPECULAR_TEXTURE_PATH "textures/container_specular.png"
+#define EMISSION_TEXTURE_PATH "textures/container_emission.jpg"
+
+// the instances start at base bytes into instanceVbo
+static void setupInstanceAttributes(unsigned int vao, unsigned int instanceVbo, bool normals, GLintptr base = 0)
+{
+	GLState::bindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	for (int i = 0; i < 4; i++) {
+		GLuint location = INSTANCE_MODEL_LOCATION + i;
+		size_t offset = base + offsetof(InstanceData, model) + i * sizeof(glm::vec4);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offset);
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	}
+	for (int i = 0; normals && i < 3; i++) {
+		GLuint location = INSTANCE_NORMAL_LOCATION + i;
+		size_t offset = base + offsetof(InstanceData, normal) + i * sizeof(glm::vec3);
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offset);
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindVertexArray(0);
+}
+
+static void uploadInstances(unsigned int instanceVbo, const std::vector<InstanceData>& instances)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+Scene::Scene(int width, int height, unsigned int features)
+	: width_(width),
+	  height_(height),
+	  boxVariants_("shaders/shader_box.vs", "shaders/shader_box.fs"),
+	  shaderLight_("shaders/shader_light.vs", "shaders/shader_light.fs", true),
+	  shaderFallback_("shaders/shader_fallback.vs", "shaders/shader_fallback.fs"),
+	  shaderBox_(nullptr),
+	  pendingBox_(nullptr),
+	  features_(0),
+	  boxFeatures_(0),
+	  lightReady_(false),
+	  cameraBlock_("Camera", CAMERA_BLOCK_BINDING),
+	  lightsBlock_("Lights", LIGHTS_BLOCK_BINDING),
+	  decodePool_(TEXTURE_DECODE_WORKERS),
+	  clusters_(threadPool_),
+	  textures_(decodePool_),
+	  profiler_(nullptr),
+	  cubeMesh_(meshArena_, buildMesh(cubeVertices, std::size(cubeVertices) / 8)),
+	  gpuDriven_(false),
+	  emissionMap_(0),
+	  culling_(true),
+	  occlusionCulling_(false),
+	  depthSort_(true),
+	  occlusion_(threadPool_),
+	  cullStats_(),
+	  boxBvhDirty_(true),
+	  boxBvhBuildCost_(0.0f)
+{
+#pragma region BuffersSetting
+	// the light markers share the cube mesh but only read positions
+	glGenVertexArrays(1, &cubeVao_);
+	cubeMesh_.setupAttributes(cubeVao_, 3);
+	glGenVertexArrays(1, &lightVao_);
+	cubeMesh_.setupAttributes(lightVao_, 1);
+
+	glGenBuffers(1, &boxInstanceVbo_);
+	glGenBuffers(1, &lightInstanceVbo_);
+	setupInstanceAttributes(cubeVao_, boxInstanceVbo_, true);
+	setupInstanceAttributes(lightVao_, lightInstanceVbo_, false);
+	boxMaterial_.id = BOX_MATERIAL_ID;
+	fallbackMaterial_.id = FALLBACK_MATERIAL_ID;
+	queue_.setPassName(SCENE_PASS_LIGHTS, "light pass");
+	queue_.setPassName(SCENE_PASS_BOXES, "box pass");
+	setBoxInstances(defaultBoxInstances());
+	setPointLights(defaultPointLights());
+	occlusion_.resize(width, height);
+#pragma endregion
+
+#pragma region TextureLoad
+	diffuseMap_ = textures_.load(DIFFUSE_TEXTURE_PATH);
+	specularMap_ = textures_.load(SPECULAR_TEXTURE_PATH);
+#pragma endregion
+
+	// the box and light programs keep compiling in the background, see updatePrograms
+	programs_.add(shaderLight_);
+	setFeatures(features);
+	setupFallbackProgram(shaderFallback_);
+
+#pragma region UniformBlocks
+	lightsBlock_.data = defaultLights();
+#pragma endregion
+}
+
+Scene::~Scene()
+{
+	GLState::deleteVertexArrays(1, &cubeVao_);
+	GLState::deleteVertexArrays(1, &lightVao_);
+	glDeleteBuffers(1, &boxInstanceVbo_);
+	glDeleteBuffers(1, &lightInstanceVbo_);
+	GLState::deleteTextures(1, &diffuseMap_);
+	GLState::deleteTextures(1, &specularMap_);
+	if (emissionMap_)
+		GLState::deleteTextures(1, &emissionMap_);
+}
+
+void Scene::resize(int width, int height)
+{
+	width_ = width;
+	height_ = height;
+	occlusion_.resize(width, height);
+}
+
+void Scene::finishLoading()
+{
+	textures_.finish();
+	programs_.finish();
+	updatePrograms();
+}
+
+void Scene::setFeatures(unsigned int features)
+{
+	features_ = features;
+	ShaderDefines defines;
+	if (features & FEATURE_DIR_LIGHT)
+		defines.push_back("DIR_LIGHT");
+	if (features & FEATURE_POINT_LIGHTS)
+		defines.push_back("POINT_LIGHTS");
+	if (features & FEATURE_SPOT_LIGHT)
+		defines.push_back("SPOT_LIGHT");
+	if (features & FEATURE_EMISSION) {
+		defines.push_back("MATERIAL_EMISSION");
+		if (!emissionMap_) {
+			emissionMap_ = textures_.load(EMISSION_TEXTURE_PATH);
+			if (hotReload_)
+				hotReload_->watchTexture(EMISSION_TEXTURE_PATH, emissionMap_);
+		}
+	}
+	Shader& variant = boxVariants_.get(defines, &programs_);
+	pendingBox_ = &variant == shaderBox_ ? nullptr : &variant;
+	if (hotReload_)
+		watchBoxProgram(variant);
+}
+
+void Scene::enableHotReload()
+{
+	if (hotReload_)
+		return;
+	hotReload_.reset(new HotReload(programs_, textures_));
+	boxVariants_.forEach([this](Shader& variant) { watchBoxProgram(variant); });
+	hotReload_->watchShader(shaderLight_, [this](Shader& shader) { setupLightProgram(shader); });
+	hotReload_->watchShader(shaderFallback_, [this](Shader& shader) { setupFallbackProgram(shader); });
+	hotReload_->watchTexture(DIFFUSE_TEXTURE_PATH, diffuseMap_);
+	hotReload_->watchTexture(SPECULAR_TEXTURE_PATH, specularMap_);
+	if (emissionMap_)
+		hotReload_->watchTexture(EMISSION_TEXTURE_PATH, emissionMap_);
+}
+
+void Scene::watchBoxProgram(Shader& variant)
+{
+	hotReload_->watchShader(variant, [this](Shader& shader) { setupBoxProgram(shader); });
+}
+
+// uniforms and block bindings live in the program object, so these run
+// again for every new program, including hot reloaded ones
+void Scene::setupBoxProgram(Shader& shader)
+{
+	shader.use();
+	shader.setInt("material.diffuse", 0);
+	shader.setInt("material.specular", 1);
+	shader.setInt("material.emission", EMISSION_TEXTURE_UNIT);
+	shader.setFloat("material.shininess", 32.0f);
+	cameraBlock_.bind(shader);
+	lightsBlock_.bind(shader);
+	clusters_.bind(shader);
+}
+
+void Scene::setupLightProgram(Shader& shader)
+{
+	shader.use();
+	shader.setVec3("lightColor", glm::vec3(1.0f));
+	cameraBlock_.bind(shader);
+}
+
+void Scene::setupFallbackProgram(Shader& shader)
+{
+	shader.use();
+	shader.setInt("diffuseMap", 0);
+	cameraBlock_.bind(shader);
+}
+
+void Scene::updatePrograms()
+{
+	if (!pendingBox_ && lightReady_)
+		return;
+	programs_.poll();
+	if (pendingBox_ && !pendingBox_->isPending()) {
+		// setting everything again for a variant seen before is harmless
+		shaderBox_ = pendingBox_;
+		pendingBox_ = nullptr;
+		boxFeatures_ = features_;
+		setupBoxProgram(*shaderBox_);
+	}
+	if (!lightReady_ && !shaderLight_.isPending()) {
+		lightReady_ = true;
+		setupLightProgram(shaderLight_);
+	}
+}
+
+std::vector<glm::mat4> Scene::defaultBoxInstances()
+{
+	std::vector<glm::mat4> models;
+	for (int i = 0; i < std::size(cubePositions); i++) {
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, cubePositions[i]);
+		model = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
+		models.push_back(model);
+	}
+	return models;
+}
+
+void Scene::setBoxInstances(const std::vector<glm::mat4>& models)
+{
+	boxInstances_.resize(models.size());
+	for (size_t i = 0; i < models.size(); i++)
+		boxInstances_[i].model = models[i];
+	computeNormalMatrices(boxInstances_.data(), boxInstances_.size());
+	uploadInstances(boxInstanceVbo_, boxInstances_);
+	resetCulling(boxInstances_, boxCull_);
+	if (boxDraws_)
+		boxDraws_->setBounds(boxCull_.bounds);
+	boxBvhDirty_ = true;
+}
+
+const Bvh& Scene::getBoxBvh()
+{
+	if (!boxBvhDirty_)
+		return boxBvh_;
+	boxBvhDirty_ = false;
+	std::vector<Aabb> bounds(boxInstances_.size());
+	for (size_t i = 0; i < boxInstances_.size(); i++)
+		bounds[i] = transformedCubeBounds(boxInstances_[i].model);
+	if (boxBvh_.getObjectCount() == bounds.size() && bounds.size() > 0
+		&& boxBvh_.refit(bounds.data()) <= BVH_REBUILD_COST * boxBvhBuildCost_)
+		return boxBvh_;
+	boxBvh_.build(bounds.data(), bounds.size());
+	boxBvhBuildCost_ = boxBvh_.getCost();
+	return boxBvh_;
+}
+
+bool Scene::pickBox(Camera& cam, float ndcX, float ndcY, BvhHit& hit)
+{
+	Ray ray = screenRay(cam.getViewMat(), getProjection(cam), ndcX, ndcY);
+	// from the eye rather than the near plane, so distances are from the camera
+	ray.origin = cam.getCamPos();
+	// slabs of the unit cube in its own space, where the ray keeps its parameter
+	return getBoxBvh().raycast(ray, hit, [this](unsigned int index, const Ray& ray) {
+		glm::mat4 inverse = glm::inverse(boxInstances_[index].model);
+		glm::vec3 origin = glm::vec3(inverse * glm::vec4(ray.origin, 1.0f));
+		glm::vec3 direction = glm::vec3(inverse * glm::vec4(ray.direction, 0.0f));
+		glm::vec3 t0 = (glm::vec3(-0.5f) - origin) / direction;
+		glm::vec3 t1 = (glm::vec3(0.5f) - origin) / direction;
+		glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+		float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+		float exit = glm::min(glm::min(tFar.x, tFar.y), tFar.z);
+		return enter <= exit ? enter : -1.0f;
+	});
+}
+
+LightsBlock Scene::defaultLights()
+{
+	LightsBlock lights = {};
+	DirLightStd140 &dLight = lights.dLight;
+	dLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	dLight.ambient = glm::vec3(0.01f);
+	dLight.diffuse = glm::vec3(0.4f);
+	dLight.specular = glm::vec3(0.5f);
+	SpotLightStd140 &sLight = lights.sLight;
+	sLight.ambient = glm::vec3(0.2f);
+	sLight.diffuse = glm::vec3(0.5f);
+	sLight.specular = glm::vec3(1.0f);
+	sLight.cutoff = glm::cos(glm::radians(12.5f));
+	sLight.outerCutoff = glm::cos(glm::radians(17.5f));
+	sLight.constant = 1.0f;
+	sLight.linear = 0.045f;
+	sLight.quadratic = 0.0075f;
+	return lights;
+}
+
+const float* Scene::cubeVertexData(size_t& vertexCount)
+{
+	vertexCount = std::size(cubeVertices) / 8;
+	return cubeVertices;
+}
+
+std::vector<PointLight> Scene::defaultPointLights()
+{
+	std::vector<PointLight> lights;
+	for (int i = 0; i < std::size(lightPositions); i++) {
+		PointLight light;
+		light.position = lightPositions[i];
+		light.ambient = glm::vec3(0.05f);
+		light.diffuse = glm::vec3(0.5f);
+		light.specular = glm::vec3(1.0f);
+		light.constant = 1.0f;
+		light.linear = 0.045f;
+		light.quadratic = 0.0075f;
+		lights.push_back(light);
+	}
+	return lights;
+}
+
+void Scene::setPointLights(const std::vector<PointLight>& lights)
+{
+	clusters_.setLights(lights);
+	// light markers are unlit, they only need the model matrix
+	lightInstances_.clear();
+	for (const PointLight& light : clusters_.getLights()) {
+		InstanceData instance;
+		instance.model = glm::mat4(1.0f);
+		instance.model = glm::translate(instance.model, light.position);
+		instance.model = glm::scale(instance.model, glm::vec3(0.1f));
+		instance.normal = glm::mat3(1.0f);
+		lightInstances_.push_back(instance);
+	}
+	uploadInstances(lightInstanceVbo_, lightInstances_);
+	resetCulling(lightInstances_, lightCull_);
+	if (lightDraws_)
+		lightDraws_->setBounds(lightCull_.bounds);
+}
+
+// spheres around the transformed cube, scaled by the longest model axis
+void Scene::resetCulling(const std::vector<InstanceData>& instances, CulledInstances& culled)
+{
+	culled.bounds.resize(instances.size());
+	for (size_t i = 0; i < instances.size(); i++) {
+		const glm::mat4& m = instances[i].model;
+		float scale = glm::max(glm::length(glm::vec3(m[0])), glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+		culled.bounds.set(i, glm::vec3(m[3]), CUBE_BOUND_RADIUS * scale);
+	}
+	// sized once here so culling every frame never allocates
+	culled.visible.resize(culled.bounds.x.size());
+	culled.order.resize(culled.bounds.x.size());
+	culled.orderScratch.resize(culled.bounds.x.size());
+	culled.nearestDepth = 0.0f;
+	culled.drawCount = (GLsizei)instances.size();
+}
+
+size_t Scene::cullInstances(const Frustum& frustum, const Bvh* bvh, CulledInstances& culled)
+{
+	return bvh ? bvh->queryFrustum(frustum, culled.visible.data())
+		: cullSpheres(frustum, culled.bounds, culled.visible.data());
+}
+
+void Scene::selectAll(CulledInstances& culled)
+{
+	for (size_t i = 0; i < culled.visible.size(); i++)
+		culled.visible[i] = (unsigned int)i;
+}
+
+void Scene::sortVisible(const glm::vec3& eye, const glm::vec3& forward, CulledInstances& culled, size_t count)
+{
+	culled.nearestDepth = 0.0f;
+	if (count == 0)
+		return;
+	// view depth of the centers, the spheres are small against the far plane
+	const BoundingSpheres& bounds = culled.bounds;
+	RenderQueue::SortEntry* order = culled.order.data();
+	const float scale = 1.0f / CAMERA_Z_FAR;
+	for (size_t i = 0; i < count; i++) {
+		unsigned int index = culled.visible[i];
+		float depth = ((bounds.x[index] - eye.x) * forward.x + (bounds.y[index] - eye.y) * forward.y
+			+ (bounds.z[index] - eye.z) * forward.z) * scale;
+		order[i] = { RenderQueue::depthBits(depth), index };
+	}
+	RenderQueue::radixSort(order, culled.orderScratch.data(), count);
+	for (size_t i = 0; i < count; i++)
+		culled.visible[i] = order[i].index;
+	culled.nearestDepth = (float)order[0].key / (float)((1 << QUEUE_DEPTH_BITS) - 1);
+}
+
+void Scene::streamVisible(unsigned int vao, unsigned int instanceVbo, bool normals,
+	const std::vector<InstanceData>& instances, CulledInstances& culled, size_t count, bool reordered)
+{
+	culled.drawCount = (GLsizei)count;
+	culled.baseInstance = 0;
+	if (count == 0)
+		return;
+	InstanceData* mapped = nullptr;
+	// with base instances the attributes stay at the start of the ring and the
+	// draw picks this frame's slice; moving the attributes instead makes some
+	// drivers rebuild their vertex fetch every frame
+	bool baseInstance = GLExt::hasBaseInstance;
+	GLintptr offset = 0;
+	if (count < instances.size() || reordered) {
+		mapped = (InstanceData*)stream_.map(count * sizeof(InstanceData),
+			baseInstance ? sizeof(InstanceData) : sizeof(glm::vec4), offset);
+		if (mapped) {
+			for (size_t i = 0; i < count; i++)
+				mapped[i] = instances[culled.visible[i]];
+		}
+		else {
+			std::cout << "ERROR::SCENE::STREAM_MAP_FAILED drawing all " << instances.size() << " instances" << std::endl;
+		}
+		stream_.unmap();
+	}
+	// all of them draw straight from the instance buffer
+	if (!mapped) {
+		culled.drawCount = (GLsizei)instances.size();
+		if (culled.streamed) {
+			setupInstanceAttributes(vao, instanceVbo, normals);
+			culled.streamed = false;
+		}
+		return;
+	}
+	unsigned int grows = stream_.getStats().grows;
+	if (!baseInstance)
+		setupInstanceAttributes(vao, stream_.getBuffer(), normals, offset);
+	else if (!culled.streamed || culled.streamGrows != grows)
+		setupInstanceAttributes(vao, stream_.getBuffer(), normals);
+	culled.baseInstance = baseInstance ? (GLuint)(offset / sizeof(InstanceData)) : 0;
+	culled.streamed = true;
+	culled.streamGrows = grows;
+}
+
+bool Scene::setGpuDriven(bool enabled)
+{
+	if (!enabled) {
+		gpuDriven_ = false;
+		return true;
+	}
+	if (!IndirectDraws::isSupported()) {
+		std::cout << "ERROR::SCENE::GPU_DRIVEN_NOT_SUPPORTED needs GL 4.3, the context is "
+			<< GLExt::getVersion() / 10 << "." << GLExt::getVersion() % 10 << std::endl;
+		return false;
+	}
+	if (!boxDraws_) {
+		boxDraws_.reset(new IndirectDraws(cubeMesh_));
+		lightDraws_.reset(new IndirectDraws(cubeMesh_));
+		if (!boxDraws_->isValid() || !lightDraws_->isValid()) {
+			boxDraws_.reset();
+			lightDraws_.reset();
+			return false;
+		}
+		boxDraws_->setBounds(boxCull_.bounds);
+		lightDraws_->setBounds(lightCull_.bounds);
+	}
+	gpuDriven_ = true;
+	return true;
+}
+
+void Scene::submitInstances(unsigned int pass, GLuint program, const Material* material, unsigned int vao,
+	const IndirectDraws* draws, const CulledInstances& culled)
+{
+	// nothing visible needs no program either
+	if (!gpuDriven_ && culled.drawCount == 0)
+		return;
+	RenderItem item;
+	item.program = program;
+	item.vao = vao;
+	item.material = material;
+	item.mesh = &cubeMesh_;
+	item.instances = culled.drawCount;
+	item.baseInstance = culled.baseInstance;
+	item.indirect = gpuDriven_ ? draws : nullptr;
+	queue_.submit(RenderQueue::makeKey(pass, program, material ? material->id : 0, vao, culled.nearestDepth), item);
+}
+
+glm::mat4 Scene::getProjection(Camera& cam) const
+{
+	return glm::perspective(glm::radians(cam.getFovY()), (float)width_ / (float)height_, CAMERA_Z_NEAR, CAMERA_Z_FAR);
+}
+
+void Scene::render(Camera& cam)
+{
+	// swap in whatever finished decoding or compiling since the last frame
+	{
+		ProfileScope scope(profiler_, "uploads");
+		if (hotReload_)
+			hotReload_->update();
+		textures_.processUploads();
+		updatePrograms();
+	}
+
+	GLState::enable(GL_DEPTH_TEST);
+	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// 每帧一次性上传相机与光照
+	stream_.beginFrame();
+	const float zNear = CAMERA_Z_NEAR, zFar = CAMERA_Z_FAR;
+	cameraBlock_.data.view = cam.getViewMat();
+	cameraBlock_.data.project = getProjection(cam);
+	cameraBlock_.data.viewPos = cam.getCamPos();
+	cameraBlock_.upload(stream_);
+	SpotLightStd140 &sLight = lightsBlock_.data.sLight;
+	sLight.position = cam.getCamPos();
+	sLight.direction = cam.getCamFront();
+	lightsBlock_.upload(stream_);
+	if (boxFeatures_ & FEATURE_POINT_LIGHTS) {
+		ProfileScope scope(profiler_, "clusters");
+		clusters_.update(cameraBlock_.data.view, glm::radians(cam.getFovY()), width_, height_, zNear, zFar, stream_);
+	}
+	{
+		ProfileScope scope(profiler_, "culling");
+		auto start = std::chrono::high_resolution_clock::now();
+		glm::mat4 viewProject = cameraBlock_.data.project * cameraBlock_.data.view;
+		bool lights = (features_ & FEATURE_POINT_LIGHTS) != 0;
+		size_t boxCount = boxInstances_.size(), lightCount = lightInstances_.size();
+		if (gpuDriven_) {
+			// every plane passes everything when culling is off
+			Frustum frustum;
+			for (glm::vec4& plane : frustum.planes)
+				plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			if (culling_)
+				frustum = extractFrustum(viewProject);
+			boxDraws_->cull(frustum);
+			if (lights)
+				lightDraws_->cull(frustum);
+		}
+		else if (culling_) {
+			Frustum frustum = extractFrustum(viewProject);
+			const Bvh* bvh = boxInstances_.size() >= BVH_CULL_MIN_BOXES ? &getBoxBvh() : nullptr;
+			boxCount = cullInstances(frustum, bvh, boxCull_);
+			if (lights)
+				lightCount = cullInstances(frustum, nullptr, lightCull_);
+		}
+		cullStats_.occluders = cullStats_.occludedBoxes = cullStats_.occludedLights = 0;
+		cullStats_.occlusionMs = 0.0;
+		if (culling_ && occlusionCulling_ && !gpuDriven_) {
+			ProfileScope occlusionScope(profiler_, "occlusion");
+			occlusion_.render(viewProject, cam.getCamPos(), boxInstances_.data(), boxCull_.bounds,
+				boxCull_.visible.data(), boxCount);
+			size_t frustumBoxes = boxCount, frustumLights = lightCount;
+			boxCount = occlusion_.cull(boxInstances_.data(), boxCull_.visible.data(), boxCount);
+			if (lights)
+				lightCount = occlusion_.cull(lightInstances_.data(), lightCull_.visible.data(), lightCount);
+			const OcclusionBuffer::Stats& stats = occlusion_.getStats();
+			cullStats_.occluders = stats.occluders;
+			cullStats_.occludedBoxes = frustumBoxes - boxCount;
+			cullStats_.occludedLights = lights ? frustumLights - lightCount : 0;
+			cullStats_.occlusionMs = stats.rasterMs + stats.testMs;
+		}
+		// nearest first for early depth rejection, also when nothing was culled:
+		// the sorted set then streams in full instead of drawing from the
+		// instance buffer; the GPU path draws in its own order
+		boxCull_.nearestDepth = lightCull_.nearestDepth = 0.0f;
+		bool sorted = depthSort_ && !gpuDriven_;
+		if (sorted) {
+			if (!culling_) {
+				selectAll(boxCull_);
+				selectAll(lightCull_);
+			}
+			sortVisible(cam.getCamPos(), cam.getCamFront(), boxCull_, boxCount);
+			if (lights)
+				sortVisible(cam.getCamPos(), cam.getCamFront(), lightCull_, lightCount);
+		}
+		streamVisible(cubeVao_, boxInstanceVbo_, true, boxInstances_, boxCull_, boxCount, sorted);
+		if (lights)
+			streamVisible(lightVao_, lightInstanceVbo_, false, lightInstances_, lightCull_, lightCount, sorted);
+		cullStats_.boxes = boxInstances_.size();
+		cullStats_.visibleBoxes = boxCull_.drawCount;
+		cullStats_.lights = lightInstances_.size();
+		cullStats_.visibleLights = lightCull_.drawCount;
+		cullStats_.cullMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// 光源与被摄物体，排序后统一绘制
+	queue_.clear();
+	if (lightReady_ && (features_ & FEATURE_POINT_LIGHTS))
+		submitInstances(SCENE_PASS_LIGHTS, shaderLight_.id, nullptr, lightVao_, lightDraws_.get(), lightCull_);
+	if (!shaderBox_) {
+		fallbackMaterial_.clear();
+		fallbackMaterial_.add(0, GL_TEXTURE_2D, diffuseMap_);
+		submitInstances(SCENE_PASS_BOXES, shaderFallback_.id, &fallbackMaterial_, cubeVao_, boxDraws_.get(), boxCull_);
+	}
+	else {
+		boxMaterial_.clear();
+		boxMaterial_.add(0, GL_TEXTURE_2D, diffuseMap_);
+		boxMaterial_.add(1, GL_TEXTURE_2D, specularMap_);
+		if (boxFeatures_ & FEATURE_POINT_LIGHTS)
+			clusters_.addTextures(boxMaterial_);
+		if (boxFeatures_ & FEATURE_EMISSION)
+			boxMaterial_.add(EMISSION_TEXTURE_UNIT, GL_TEXTURE_2D, emissionMap_);
+		submitInstances(SCENE_PASS_BOXES, shaderBox_->id, &boxMaterial_, cubeVao_, boxDraws_.get(), boxCull_);
+	}
+	queue_.execute(profiler_);
+	stream_.endFrame();
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "camera.h"
+#include "bvh.h"
+#include "clusters.h"
+#include "culling.h"
+#include "hot_reload.h"
+#include "indirect_draws.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "profiler.h"
+#include "render_queue.h"
+#include "scene_blocks.h"
+#include "shader_batch.h"
+#include "shader_variants.h"
+#include "stream_buffer.h"
+#include "texture.h"
+#include "thread_pool.h"
+#include "transform.h"
+
+// lighting features of the box program, each one a #define in shader_box.fs
+enum SceneFeature
+{
+	FEATURE_DIR_LIGHT = 1 << 0,
+	FEATURE_POINT_LIGHTS = 1 << 1,
+	FEATURE_SPOT_LIGHT = 1 << 2,
+	FEATURE_EMISSION = 1 << 3,
+	FEATURE_DEFAULT = FEATURE_DIR_LIGHT | FEATURE_POINT_LIGHTS | FEATURE_SPOT_LIGHT,
+};
+
+// The box/light scene: owns the programs, buffers, textures and uniform
+// blocks, and draws one frame for a given camera. Shared by the interactive
+// renderer and learnopengl_bench so both run exactly the same frame.
+// Requires a current GL context for its whole lifetime.
+class Scene
+{
+public:
+	Scene(int width, int height, unsigned int features = FEATURE_DEFAULT);
+	~Scene();
+
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	void render(Camera& cam);
+	void resize(int width, int height);
+
+	// replace the cube field, all boxes are drawn with one instanced call.
+	// Passing as many boxes as before counts as moving them: the BVH over
+	// the boxes is refit, and only rebuilt once the refits doubled its cost.
+	void setBoxInstances(const std::vector<glm::mat4>& models);
+	// cubePositions from data.h with their 20 degree per-index rotation
+	static std::vector<glm::mat4> defaultBoxInstances();
+	size_t getBoxCount() const { return boxInstances_.size(); }
+
+	// replace the point lights, each also gets a light marker cube
+	void setPointLights(const std::vector<PointLight>& lights);
+	// one light per lightPositions entry from data.h
+	static std::vector<PointLight> defaultPointLights();
+	const LightClusters& getClusters() const { return clusters_; }
+	// the directional light and the spot light; render() moves the spot light to the camera
+	static LightsBlock defaultLights();
+	// interleaved position(3) normal(3) uv(2) floats of the cube, unindexed triangles
+	static const float* cubeVertexData(size_t& vertexCount);
+
+	// pick the box program variant, a SceneFeature mask; a variant that is not
+	// built yet compiles in the background while the current one keeps drawing.
+	// Disabled features cost nothing per frame, without FEATURE_POINT_LIGHTS the
+	// clusters are not even assigned.
+	void setFeatures(unsigned int features);
+	unsigned int getFeatures() const { return features_; }
+	ThreadPool& getThreadPool() { return threadPool_; }
+	// for background work like image decodes, never used for parallelFor
+	ThreadPool& getDecodePool() { return decodePool_; }
+
+	// textures stream in and programs compile while frames render; block until
+	// all are in place. Until then boxes are drawn with the fallback program
+	// and the light markers are skipped.
+	void finishLoading();
+	const TextureLoader& getTextureLoader() const { return textures_; }
+
+	struct CullStats
+	{
+		size_t boxes;
+		size_t visibleBoxes;
+		size_t lights;
+		size_t visibleLights;
+		// boxes and light markers inside the frustum found hidden behind the occluders
+		size_t occluders;
+		size_t occludedBoxes;
+		size_t occludedLights;
+		double cullMs;
+		// part of cullMs spent drawing occluders and testing against them
+		double occlusionMs;
+	};
+
+	// skip boxes and light markers whose bounding sphere is outside the view
+	// frustum, on by default; the survivors are written to the stream buffer
+	// every frame and drawn from there, see also setDepthSort
+	void setCulling(bool enabled) { culling_ = enabled; }
+	bool getCulling() const { return culling_; }
+	// after the frustum, also skip what is hidden behind the nearest boxes, see
+	// OcclusionBuffer; off by default, it only pays off when boxes hide others
+	void setOcclusionCulling(bool enabled) { occlusionCulling_ = enabled; }
+	bool getOcclusionCulling() const { return occlusionCulling_; }
+	// order the drawn instances nearest first, on by default; they then stream
+	// every frame even when culling is off or nothing was culled
+	void setDepthSort(bool enabled) { depthSort_ = enabled; }
+	bool getDepthSort() const { return depthSort_; }
+	const OcclusionBuffer& getOcclusionBuffer() const { return occlusion_; }
+	// per frame data: the Camera and Lights blocks and the instances left after culling
+	const StreamBuffer& getStreamBuffer() const { return stream_; }
+	// draws and state changes of the last frame
+	const RenderQueue& getRenderQueue() const { return queue_; }
+
+	// cull and draw the boxes and light markers on the GPU, each set with one
+	// multi-draw indirect call, see IndirectDraws. Replaces the CPU frustum and
+	// occlusion culling, CullStats then count every object as visible. Needs
+	// GL 4.3; without it this returns false and the CPU path stays.
+	bool setGpuDriven(bool enabled);
+	bool getGpuDriven() const { return gpuDriven_; }
+	// boxes drawn by the last frame, waits for the GPU; 0 unless the GPU compacts the commands
+	size_t readGpuVisibleBoxes() const { return boxDraws_ ? boxDraws_->readDrawCount() : 0; }
+	const CullStats& getCullStats() const { return cullStats_; }
+
+	// box under a point given in normalized device coordinates, (0, 0) is the
+	// screen center; the BVH finds the candidates, the hit is on the rotated cube
+	bool pickBox(Camera& cam, float ndcX, float ndcY, BvhHit& hit);
+	// the BVH is built when culling or picking first needs it
+	const Bvh& getBoxBvh();
+
+	// time the sections of render() with this profiler, nullptr to stop
+	void setProfiler(Profiler* profiler) { profiler_ = profiler; }
+
+	// watch the shader and texture files and rebuild whatever changes, see HotReload
+	void enableHotReload();
+	const HotReload* getHotReload() const { return hotReload_.get(); }
+
+	// the variant currently drawing, only valid once finishLoading() returned
+	const Shader& getBoxShader() const { return *shaderBox_; }
+	const Shader& getLightShader() const { return shaderLight_; }
+	const Mesh& getCubeMesh() const { return cubeMesh_; }
+	MeshArena& getMeshArena() { return meshArena_; }
+
+private:
+	// bounds of one instance buffer and which of its instances are drawn
+	struct CulledInstances
+	{
+		BoundingSpheres bounds;
+		std::vector<unsigned int> visible;
+		// the vao reads this frame's visible instances from the stream buffer
+		// rather than all of them from the instance buffer; streamGrows is the
+		// stream buffer's grow count when the vao was pointed at it
+		bool streamed = false;
+		unsigned int streamGrows = 0;
+		GLsizei drawCount;
+		// first instance of this frame's slice of the stream buffer
+		GLuint baseInstance = 0;
+		// depth sort of the visible instances, sized with visible
+		std::vector<RenderQueue::SortEntry> order;
+		std::vector<RenderQueue::SortEntry> orderScratch;
+		// of the nearest drawn instance, in [0, 1] of the far plane distance
+		float nearestDepth = 0.0f;
+	};
+
+	static void resetCulling(const std::vector<InstanceData>& instances, CulledInstances& culled);
+	// visible instances to the front of culled.visible, returns how many
+	static size_t cullInstances(const Frustum& frustum, const Bvh* bvh, CulledInstances& culled);
+	// every instance in culled.visible, in index order
+	static void selectAll(CulledInstances& culled);
+	// the first count of culled.visible nearest first, so the batch draws front to back
+	static void sortVisible(const glm::vec3& eye, const glm::vec3& forward, CulledInstances& culled, size_t count);
+	// draw the first count of culled.visible; all instances straight from the
+	// instance buffer if that is every one and they were not reordered
+	void streamVisible(unsigned int vao, unsigned int instanceVbo, bool normals,
+		const std::vector<InstanceData>& instances, CulledInstances& culled, size_t count, bool reordered);
+	void submitInstances(unsigned int pass, GLuint program, const Material* material, unsigned int vao,
+		const IndirectDraws* draws, const CulledInstances& culled);
+	glm::mat4 getProjection(Camera& cam) const;
+	// finalize finished programs and hook up the ones that just became ready
+	void updatePrograms();
+	void watchBoxProgram(Shader& variant);
+	void setupBoxProgram(Shader& shader);
+	void setupLightProgram(Shader& shader);
+	void setupFallbackProgram(Shader& shader);
+
+	int width_;
+	int height_;
+
+	// declared first so the driver gets its compiler threads before any compile
+	ShaderBatch programs_;
+	ShaderVariants boxVariants_;
+	Shader shaderLight_;
+	Shader shaderFallback_;
+	// the box variant drawing now and the one replacing it once it is built
+	Shader* shaderBox_;
+	Shader* pendingBox_;
+	unsigned int features_;
+	unsigned int boxFeatures_;
+	bool lightReady_;
+	StreamBuffer stream_;
+	UniformBlock<CameraBlock> cameraBlock_;
+	UniformBlock<LightsBlock> lightsBlock_;
+	ThreadPool threadPool_;
+	// decodes take milliseconds; in threadPool_ they would hold up every
+	// parallelFor queued behind them, so they get threads of their own
+	ThreadPool decodePool_;
+	LightClusters clusters_;
+	TextureLoader textures_;
+	// after everything it watches, so it goes first
+	std::unique_ptr<HotReload> hotReload_;
+	Profiler* profiler_;
+
+	// every mesh lives in it, so it has to outlive them
+	MeshArena meshArena_;
+	Mesh cubeMesh_;
+	bool gpuDriven_;
+	std::unique_ptr<IndirectDraws> boxDraws_;
+	std::unique_ptr<IndirectDraws> lightDraws_;
+	unsigned int cubeVao_;
+	unsigned int lightVao_;
+	unsigned int boxInstanceVbo_;
+	unsigned int lightInstanceVbo_;
+	std::vector<InstanceData> boxInstances_;
+	std::vector<InstanceData> lightInstances_;
+	unsigned int diffuseMap_;
+	unsigned int specularMap_;
+	unsigned int emissionMap_;
+	bool culling_;
+	bool occlusionCulling_;
+	bool depthSort_;
+	OcclusionBuffer occlusion_;
+	CulledInstances boxCull_;
+	CulledInstances lightCull_;
+	CullStats cullStats_;
+	Bvh boxBvh_;
+	// setBoxInstances changed the boxes since the BVH was built or refit
+	bool boxBvhDirty_;
+	float boxBvhBuildCost_;
+
+	RenderQueue queue_;
+	Material boxMaterial_;
+	Material fallbackMaterial_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "uniform_block.h"
+
+#define CAMERA_BLOCK_BINDING 0
+#define LIGHTS_BLOCK_BINDING 1
+#define CLUSTERS_BLOCK_BINDING 2
+
+static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::mat4) == 64, "glm types must be tightly packed");
+
+// layout (std140) uniform Camera
+struct CameraBlock
+{
+	glm::mat4 view;
+	glm::mat4 project;
+	glm::vec3 viewPos;
+	float pad0;
+};
+STD140_OFFSET(CameraBlock, view, 0);
+STD140_OFFSET(CameraBlock, project, 64);
+STD140_OFFSET(CameraBlock, viewPos, 128);
+
+struct DirLightStd140
+{
+	glm::vec3 direction;
+	float pad0;
+	glm::vec3 ambient;
+	float pad1;
+	glm::vec3 diffuse;
+	float pad2;
+	glm::vec3 specular;
+	float pad3;
+};
+STD140_OFFSET(DirLightStd140, direction, 0);
+STD140_OFFSET(DirLightStd140, ambient, 16);
+STD140_OFFSET(DirLightStd140, diffuse, 32);
+STD140_OFFSET(DirLightStd140, specular, 48);
+
+struct SpotLightStd140
+{
+	glm::vec3 position;
+	float pad0;
+	glm::vec3 direction;
+	float pad1;
+	glm::vec3 ambient;
+	float pad2;
+	glm::vec3 diffuse;
+	float pad3;
+	glm::vec3 specular;
+	float cutoff;
+	float outerCutoff;
+	float constant;
+	float linear;
+	float quadratic;
+};
+STD140_OFFSET(SpotLightStd140, position, 0);
+STD140_OFFSET(SpotLightStd140, direction, 16);
+STD140_OFFSET(SpotLightStd140, ambient, 32);
+STD140_OFFSET(SpotLightStd140, diffuse, 48);
+STD140_OFFSET(SpotLightStd140, specular, 64);
+STD140_OFFSET(SpotLightStd140, cutoff, 76);
+STD140_OFFSET(SpotLightStd140, quadratic, 92);
+
+// layout (std140) uniform Lights, point lights go through LightClusters
+struct LightsBlock
+{
+	DirLightStd140 dLight;
+	SpotLightStd140 sLight;
+};
+STD140_OFFSET(LightsBlock, dLight, 0);
+STD140_OFFSET(LightsBlock, sLight, 64);
+
+// layout (std140) uniform Clusters
+struct ClustersBlock
+{
+	// uvec4: clusters along x, y, z and the number of point lights
+	unsigned int count[4];
+	// near, far, slice scale, slice bias: slice = log(depth) * scale + bias
+	glm::vec4 depth;
+	// cluster tile size in pixels in xy
+	glm::vec4 tile;
+};
+STD140_OFFSET(ClustersBlock, count, 0);
+STD140_OFFSET(ClustersBlock, depth, 16);
+STD140_OFFSET(ClustersBlock, tile, 32);
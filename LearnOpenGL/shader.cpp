@@ -1,6 +1,59 @@
 #include "shader.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "gl_ext.h"
+#include "program_cache.h"
+
+Shader::Stats Shader::stats = { 0, 0 };
+Shader::BuildStats Shader::buildStats = { 0, 0, 0.0, 0.0 };
+
+static double msSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// the defines go after #version, which has to stay the first directive;
+// #line keeps compiler messages pointing at the lines of the file on disk
+// (drivers number the line after "#line n" as n, like GLSL 4.20 specifies)
+static std::string injectDefines(const std::string& code, const ShaderDefines& defines)
+{
+	if (defines.empty())
+		return code;
+	size_t insertAt = 0;
+	size_t version = code.find("#version");
+	if (version != std::string::npos)
+	{
+		size_t end = code.find('\n', version);
+		insertAt = end == std::string::npos ? code.size() : end + 1;
+	}
+	int line = 1 + (int)std::count(code.begin(), code.begin() + insertAt, '\n');
+	std::string injected = code.substr(0, insertAt);
+	if (!injected.empty() && injected.back() != '\n')
+		injected += '\n';
+	for (const std::string& define : defines)
+		injected += "#define " + define + "\n";
+	injected += "#line " + std::to_string(line) + "\n";
+	injected.append(code, insertAt, std::string::npos);
+	return injected;
+}
 
 Shader::Shader(const char * vertexPath, const char * fragPath)
+	: Shader(vertexPath, fragPath, ShaderDefines(), false)
+{
+}
+
+Shader::Shader(const char * vertexPath, const char * fragPath, bool deferred)
+	: Shader(vertexPath, fragPath, ShaderDefines(), deferred)
+{
+}
+
+Shader::Shader(const char * vertexPath, const char * fragPath, const ShaderDefines& defines, bool deferred)
+	: id(0), vertex_(0), fragment_(0), cacheKey_(0), pending_(false), linked_(false),
+	  vertexPath_(vertexPath), fragPath_(fragPath), defines_(defines)
 {
 	// ļ·лȡ/Ƭɫ
 	std::string vertexCode;
@@ -30,92 +83,260 @@ Shader::Shader(const char * vertexPath, const char * fragPath)
 	{
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
+	vertexCode = injectDefines(vertexCode, defines);
+	fragmentCode = injectDefines(fragmentCode, defines);
+	// warm start: a cached binary for exactly these sources and this driver skips compilation
+	buildStart_ = std::chrono::high_resolution_clock::now();
+	cacheKey_ = ProgramCache::key(vertexCode, fragmentCode);
+	id = ProgramCache::load(cacheKey_);
+	if (id)
+	{
+		linked_ = true;
+		cacheUniforms();
+		buildStats.cacheLoads++;
+		buildStats.cacheLoadMs += msSince(buildStart_);
+		return;
+	}
+
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
-	unsigned int vertex, fragment;
-	int success;
-	char infoLog[512];
-
 	// ɫ
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
-	checkCompileErrors(vertex, "VERTEX");
+	vertex_ = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertex_, 1, &vShaderCode, NULL);
+	glCompileShader(vertex_);
 	// Ƭɫ
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-	checkCompileErrors(fragment, "FRAGMENT");
+	fragment_ = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragment_, 1, &fShaderCode, NULL);
+	glCompileShader(fragment_);
 
+	// linking right away is fine, a failed compile just fails the link;
+	// every status query waits for the driver, so they all live in finalize()
 	id = glCreateProgram();
-	glAttachShader(id, vertex);
-	glAttachShader(id, fragment);
+	glAttachShader(id, vertex_);
+	glAttachShader(id, fragment_);
+	ProgramCache::prepare(id);
 	glLinkProgram(id);
+	pending_ = true;
+	if (!deferred)
+		finalize();
+}
+
+bool Shader::isReady() const
+{
+	if (!pending_)
+		return true;
+	if (!GLExt::hasParallelShaderCompile)
+		return false;
+	GLint done = GL_FALSE;
+	glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+void Shader::finalize()
+{
+	if (!pending_)
+		return;
+	pending_ = false;
+	checkCompileErrors(vertex_, "VERTEX");
+	checkCompileErrors(fragment_, "FRAGMENT");
 	// ӡӴеĻ
-	checkCompileErrors(id, "PROGRAM");
+	linked_ = checkCompileErrors(id, "PROGRAM");
+	cacheUniforms();
 	// ɾɫѾӵǵĳˣѾҪ
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	glDeleteShader(vertex_);
+	glDeleteShader(fragment_);
+	vertex_ = fragment_ = 0;
+	buildStats.compiled++;
+	buildStats.compileMs += msSince(buildStart_);
+	ProgramCache::store(id, cacheKey_);
+}
+
+void Shader::swap(Shader& other)
+{
+	std::swap(id, other.id);
+	std::swap(vertex_, other.vertex_);
+	std::swap(fragment_, other.fragment_);
+	std::swap(cacheKey_, other.cacheKey_);
+	std::swap(buildStart_, other.buildStart_);
+	std::swap(pending_, other.pending_);
+	std::swap(linked_, other.linked_);
+	vertexPath_.swap(other.vertexPath_);
+	fragPath_.swap(other.fragPath_);
+	defines_.swap(other.defines_);
+	uniforms_.swap(other.uniforms_);
 }
 
 void Shader::use()
 {
-	glUseProgram(id);
+	GLState::useProgram(id);
+}
+
+void Shader::setBool(const char* name, bool value) const
+{
+	setBool(getUniformLocation(name), value);
 }
 
-void Shader::setBool(const std::string & name, bool value) const
+void Shader::setInt(const char* name, int value) const
 {
-	glUniform1i(glGetUniformLocation(id, name.c_str()), (int)value);
+	setInt(getUniformLocation(name), value);
 }
 
-void Shader::setInt(const std::string & name, int value) const
+void Shader::setFloat(const char* name, float value) const
 {
-	glUniform1i(glGetUniformLocation(id, name.c_str()), value);
+	setFloat(getUniformLocation(name), value);
 }
 
-void Shader::setFloat(const std::string & name, float value) const
+void Shader::setVec2(const char* name, const glm::vec2 &value) const
 {
-	glUniform1f(glGetUniformLocation(id, name.c_str()), value);
+	setVec2(getUniformLocation(name), value);
 }
 
-void Shader::setVec2(const std::string & name, const glm::vec2 &value) const
+void Shader::setVec3(const char* name, const glm::vec3 &value) const
 {
-	glUniform2fv(glGetUniformLocation(id, name.c_str()), 1, &value[0]);
+	setVec3(getUniformLocation(name), value);
 }
 
-void Shader::setVec3(const std::string & name, const glm::vec3 &value) const
+void Shader::setVec3(const char* name, float x, float y, float z) const
 {
-	glUniform3fv(glGetUniformLocation(id, name.c_str()), 1, &value[0]);
+	setVec3(getUniformLocation(name), x, y, z);
 }
 
-void Shader::setVec3(const std::string &name, float x, float y, float z) const
+void Shader::setVec4(const char* name, const glm::vec4 &value) const
 {
-	glUniform3f(glGetUniformLocation(id, name.c_str()), x, y, z);
+	setVec4(getUniformLocation(name), value);
 }
 
-void Shader::setVec4(const std::string & name, const glm::vec4 &value) const
+void Shader::setMat2(const char* name, const glm::mat2 & value) const
 {
-	glUniform4fv(glGetUniformLocation(id, name.c_str()), 1, &value[0]);
+	setMat2(getUniformLocation(name), value);
 }
 
-void Shader::setMat2(const std::string & name, const glm::mat2 & value) const
+void Shader::setMat3(const char* name, const glm::mat3 & value) const
 {
-	glUniformMatrix2fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, &value[0][0]);
+	setMat3(getUniformLocation(name), value);
 }
 
-void Shader::setMat3(const std::string & name, const glm::mat3 & value) const
+void Shader::setMat4(const char* name, const glm::mat4 & value) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, &value[0][0]);
+	setMat4(getUniformLocation(name), value);
 }
 
-void Shader::setMat4(const std::string & name, const glm::mat4 & value) const
+GLint Shader::getUniformLocation(const char* name) const
 {
-	GLint loc = glGetUniformLocation(id, name.c_str());
-	glUniformMatrix4fv(loc, 1, GL_FALSE, &value[0][0]);
+	auto it = std::lower_bound(uniforms_.begin(), uniforms_.end(), name,
+		[](const UniformEntry& entry, const char* key) { return strcmp(entry.name.c_str(), key) < 0; });
+	if (it == uniforms_.end() || strcmp(it->name.c_str(), name) != 0)
+		return -1;
+	return it->location;
+}
+
+void Shader::setBool(GLint location, bool value) const
+{
+	stats.uniformUploads++;
+	glUniform1i(location, (int)value);
+}
+
+void Shader::setInt(GLint location, int value) const
+{
+	stats.uniformUploads++;
+	glUniform1i(location, value);
+}
+
+void Shader::setFloat(GLint location, float value) const
+{
+	stats.uniformUploads++;
+	glUniform1f(location, value);
+}
+
+void Shader::setVec2(GLint location, const glm::vec2 & value) const
+{
+	stats.uniformUploads++;
+	glUniform2fv(location, 1, &value[0]);
+}
+
+void Shader::setVec3(GLint location, const glm::vec3 & value) const
+{
+	stats.uniformUploads++;
+	glUniform3fv(location, 1, &value[0]);
+}
+
+void Shader::setVec3(GLint location, float x, float y, float z) const
+{
+	stats.uniformUploads++;
+	glUniform3f(location, x, y, z);
+}
+
+void Shader::setVec4(GLint location, const glm::vec4 & value) const
+{
+	stats.uniformUploads++;
+	glUniform4fv(location, 1, &value[0]);
+}
+
+void Shader::setMat2(GLint location, const glm::mat2 & value) const
+{
+	stats.uniformUploads++;
+	glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::setMat3(GLint location, const glm::mat3 & value) const
+{
+	stats.uniformUploads++;
+	glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::setMat4(GLint location, const glm::mat4 & value) const
+{
+	stats.uniformUploads++;
+	glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::resetStats()
+{
+	stats.locationQueries = 0;
+	stats.uniformUploads = 0;
+}
+
+void Shader::cacheUniforms()
+{
+	uniforms_.clear();
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::string buffer(maxLength > 0 ? maxLength : 1, '\0');
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type;
+		glGetActiveUniform(id, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, &buffer[0]);
+		std::string name = buffer.substr(0, length);
+		GLint location = glGetUniformLocation(id, name.c_str());
+		stats.locationQueries++;
+		// members of uniform blocks have no location
+		if (location < 0)
+			continue;
+		uniforms_.push_back({ name, location });
+
+		// arrays of basic types are reported once as "name[0]", register the bare name and every element
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			std::string base = name.substr(0, name.size() - 3);
+			uniforms_.push_back({ base, location });
+			for (GLint j = 1; j < size; j++)
+			{
+				std::string element = base + "[" + std::to_string(j) + "]";
+				uniforms_.push_back({ element, glGetUniformLocation(id, element.c_str()) });
+				stats.locationQueries++;
+			}
+		}
+	}
+	std::sort(uniforms_.begin(), uniforms_.end(),
+		[](const UniformEntry& a, const UniformEntry& b) { return a.name < b.name; });
 }
 
-void Shader::checkCompileErrors(unsigned int shader, std::string type)
+bool Shader::checkCompileErrors(unsigned int shader, std::string type)
 {
 	int success;
 	char infoLog[1024];
@@ -135,4 +356,5 @@ void Shader::checkCompileErrors(unsigned int shader, std::string type)
 			std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 		}
 	}
+	return success != 0;
 }
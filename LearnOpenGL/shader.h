@@ -5,10 +5,18 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <chrono>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "uniform_name.h"
+
+// feature switches for one program permutation, each entry becomes a
+// "#define <entry>" right after #version, so "NAME" or "NAME value"
+typedef std::vector<std::string> ShaderDefines;
+
 class Shader
 {
 public:
@@ -17,22 +25,99 @@ public:
 
 	// ȡɫ
 	Shader(const char* vertexPath, const char* fragPath);
+	// deferred: submit compile and link without querying their status, the
+	// program is usable only after finalize() (see ShaderBatch)
+	Shader(const char* vertexPath, const char* fragPath, bool deferred);
+	// permutation with the given defines injected into both stages
+	Shader(const char* vertexPath, const char* fragPath, const ShaderDefines& defines, bool deferred = false);
+	// true once the driver finished compiling and linking, never blocks;
+	// without GL_KHR_parallel_shader_compile a pending program is never ready
+	bool isReady() const;
+	// check compile/link status and read the uniforms, blocks while the driver is still busy
+	void finalize();
+	bool isPending() const { return pending_; }
+	// compiled and linked without errors, meaningful once not pending
+	bool isLinked() const { return linked_; }
+	// exchange programs with a rebuild of the same files, see HotReload
+	void swap(Shader& other);
+
+	const std::string& getVertexPath() const { return vertexPath_; }
+	const std::string& getFragPath() const { return fragPath_; }
+	const ShaderDefines& getDefines() const { return defines_; }
 	// ʹ/
 	void use();
 	// uniformߺ
-	void setBool(const std::string &name, bool value) const;
-	void setInt(const std::string &name, int value) const;
-	void setFloat(const std::string &name, float value) const;
-	void setVec2(const std::string &name, const glm::vec2 &value) const;
-	void setVec3(const std::string &name, const glm::vec3 &value) const;
-	void setVec3(const std::string & name, float x, float y, float z) const;
-	void setVec4(const std::string &name, const glm::vec4 &value) const;
-	void setMat2(const std::string &name, const glm::mat2 &value) const;
-	void setMat3(const std::string &name, const glm::mat3 &value) const;
-	void setMat4(const std::string &name, const  glm::mat4 &value) const;
+	void setBool(const char* name, bool value) const;
+	void setInt(const char* name, int value) const;
+	void setFloat(const char* name, float value) const;
+	void setVec2(const char* name, const glm::vec2 &value) const;
+	void setVec3(const char* name, const glm::vec3 &value) const;
+	void setVec3(const char* name, float x, float y, float z) const;
+	void setVec4(const char* name, const glm::vec4 &value) const;
+	void setMat2(const char* name, const glm::mat2 &value) const;
+	void setMat3(const char* name, const glm::mat3 &value) const;
+	void setMat4(const char* name, const  glm::mat4 &value) const;
+
+	// uniform handles resolved once after link, -1 if the uniform is not active;
+	// lookups by const char* or UniformName do not allocate
+	GLint getUniformLocation(const char* name) const;
+	GLint getUniformLocation(const std::string &name) const { return getUniformLocation(name.c_str()); }
+	template <size_t Capacity>
+	GLint getUniformLocation(const UniformName<Capacity> &name) const { return getUniformLocation(name.c_str()); }
+	void setBool(GLint location, bool value) const;
+	void setInt(GLint location, int value) const;
+	void setFloat(GLint location, float value) const;
+	void setVec2(GLint location, const glm::vec2 &value) const;
+	void setVec3(GLint location, const glm::vec3 &value) const;
+	void setVec3(GLint location, float x, float y, float z) const;
+	void setVec4(GLint location, const glm::vec4 &value) const;
+	void setMat2(GLint location, const glm::mat2 &value) const;
+	void setMat3(GLint location, const glm::mat3 &value) const;
+	void setMat4(GLint location, const glm::mat4 &value) const;
+
+	// driver call counters shared by all programs, reset once per frame
+	struct Stats
+	{
+		unsigned int locationQueries;
+		unsigned int uniformUploads;
+	};
+	static Stats stats;
+	static void resetStats();
+
+	// program builds since startup, compiled from source or loaded from ProgramCache
+	struct BuildStats
+	{
+		unsigned int compiled;
+		unsigned int cacheLoads;
+		double compileMs;
+		double cacheLoadMs;
+	};
+	static BuildStats buildStats;
 
 private:
-	void checkCompileErrors(unsigned int shader, std::string type);
+	bool checkCompileErrors(unsigned int shader, std::string type);
+	void cacheUniforms();
+
+	// compile state between a deferred constructor and finalize()
+	unsigned int vertex_;
+	unsigned int fragment_;
+	unsigned long long cacheKey_;
+	std::chrono::high_resolution_clock::time_point buildStart_;
+	bool pending_;
+	bool linked_;
+
+	// what the program was built from, so it can be built again
+	std::string vertexPath_;
+	std::string fragPath_;
+	ShaderDefines defines_;
+
+	struct UniformEntry
+	{
+		std::string name;
+		GLint location;
+	};
+	// sorted by name, searched with strcmp so lookups never build a std::string
+	std::vector<UniformEntry> uniforms_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "shader_batch.h"
+
+#include "gl_ext.h"
+
+ShaderBatch::ShaderBatch()
+{
+	// 0xFFFFFFFF means implementation defined, i.e. as many threads as the driver likes
+	if (GLExt::hasParallelShaderCompile)
+		GLExt::maxShaderCompilerThreads(0xFFFFFFFFu);
+}
+
+void ShaderBatch::add(Shader& shader)
+{
+	if (shader.isPending())
+		pending_.push_back(&shader);
+}
+
+size_t ShaderBatch::poll()
+{
+	if (!GLExt::hasParallelShaderCompile) {
+		finish();
+		return 0;
+	}
+	size_t kept = 0;
+	for (Shader* shader : pending_) {
+		if (shader->isReady())
+			shader->finalize();
+		else
+			pending_[kept++] = shader;
+	}
+	pending_.resize(kept);
+	return kept;
+}
+
+void ShaderBatch::finish()
+{
+	for (Shader* shader : pending_)
+		shader->finalize();
+	pending_.clear();
+}
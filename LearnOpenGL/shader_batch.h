@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "shader.h"
+
+// Builds several programs together. Add deferred Shaders (constructed with
+// deferred = true) right after creating them, so every compile and link has
+// been handed to the driver before the first status query. With
+// GL_KHR_parallel_shader_compile the driver builds them on its own threads
+// and poll() finalizes whichever finished without ever blocking; without it
+// the first poll() blocks once for the whole batch, which still beats
+// blocking after every single compile.
+// The batch does not own its programs, they must outlive it or be finished.
+class ShaderBatch
+{
+public:
+	// lets the driver pick its compiler thread count when the extension is present
+	ShaderBatch();
+
+	void add(Shader& shader);
+	// finalize every program that is ready, returns how many are still pending
+	size_t poll();
+	// finalize everything, blocking until the driver is done
+	void finish();
+	size_t getPending() const { return pending_.size(); }
+
+private:
+	std::vector<Shader*> pending_;
+};
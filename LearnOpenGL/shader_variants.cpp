@@ -0,0 +1,32 @@
+#include "shader_variants.h"
+
+#include <algorithm>
+
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragPath)
+	: vertexPath_(vertexPath), fragPath_(fragPath)
+{
+}
+
+Shader& ShaderVariants::get(const ShaderDefines& defines, ShaderBatch* batch)
+{
+	ShaderDefines sorted = defines;
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+	std::string key;
+	for (const std::string& define : sorted)
+		key += define + "\n";
+
+	std::unique_ptr<Shader>& variant = variants_[key];
+	if (!variant) {
+		variant.reset(new Shader(vertexPath_.c_str(), fragPath_.c_str(), sorted, batch != nullptr));
+		if (batch)
+			batch->add(*variant);
+	}
+	return *variant;
+}
+
+void ShaderVariants::forEach(const std::function<void(Shader&)>& fn)
+{
+	for (auto& variant : variants_)
+		fn(*variant.second);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "shader.h"
+#include "shader_batch.h"
+
+// Permutations of one vertex/fragment pair, told apart by their defines.
+// A variant is built the first time it is asked for and kept until this
+// object goes away, so switching back to a feature set costs a map lookup.
+// ProgramCache keys binaries by the injected sources, every variant gets
+// its own cache file as well.
+class ShaderVariants
+{
+public:
+	ShaderVariants(const char* vertexPath, const char* fragPath);
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// the variant for these defines in any order; with a batch a new variant
+	// compiles deferred and joins the batch, otherwise it is built right away
+	Shader& get(const ShaderDefines& defines, ShaderBatch* batch = nullptr);
+	size_t size() const { return variants_.size(); }
+	void forEach(const std::function<void(Shader&)>& fn);
+
+private:
+	std::string vertexPath_;
+	std::string fragPath_;
+	// sorted defines joined by newlines; Shader is not movable once a batch points at it
+	std::map<std::string, std::unique_ptr<Shader>> variants_;
+};
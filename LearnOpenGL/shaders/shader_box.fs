@@ -1,6 +1,7 @@
 #version 330 core
+// lighting features, injected as #defines by Scene::setFeatures:
+// DIR_LIGHT, POINT_LIGHTS, SPOT_LIGHT, MATERIAL_EMISSION
 
-#define NR_POINT_LIGHTS 1
 out vec4 FragColor;
 
 in vec3 Normal;
@@ -10,6 +11,9 @@ in vec2 TexCoords;
 struct Material {
 	sampler2D diffuse;
 	sampler2D specular;
+#ifdef MATERIAL_EMISSION
+	sampler2D emission;
+#endif
 	float shininess;
 };
 struct DirLight {
@@ -44,12 +48,36 @@ struct SpotLight {
 	float quadratic;
 };
 
-uniform vec3 viewPos;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 project;
+	vec3 viewPos;
+};
+
+// per-frame light state, shared through one std140 buffer; declared by every
+// variant so the std140 layout never depends on the features
+layout (std140) uniform Lights {
+	DirLight dLight;
+	SpotLight sLight;
+};
+
+#ifdef POINT_LIGHTS
+// clustered point lights, filled by LightClusters (clusters.h)
+layout (std140) uniform Clusters {
+	uvec4 clusterCount;
+	vec4 clusterDepth;
+	vec4 clusterTile;
+};
+// 4 texels per light: position + radius, ambient + constant, diffuse + linear, specular + quadratic
+uniform samplerBuffer pointLightData;
+// first index and light count per cluster
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLightIndices;
+#endif
+
 uniform Material material;
-uniform DirLight dLight;
-uniform PointLight pLights[NR_POINT_LIGHTS];
-uniform SpotLight sLight;
 
+#ifdef DIR_LIGHT
 vec3 calcDirLight(DirLight light, vec3 normal,  vec3 viewDir) {
 	// DirLight
 	// ambient
@@ -64,7 +92,9 @@ vec3 calcDirLight(DirLight light, vec3 normal,  vec3 viewDir) {
 	vec3 specular = light.specular * spec * texture(material.specular, TexCoords).rgb;
 	return (ambient + diffuse + specular);
 }
+#endif
 
+#ifdef POINT_LIGHTS
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
 	// diffuse
 	vec3 lightDir = normalize(light.position - fragPos);
@@ -86,7 +116,9 @@ vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
 	specular *= attenuation;
 	return (ambient + diffuse + specular);
 }
+#endif
 
+#ifdef SPOT_LIGHT
 vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
 	vec3 lightDir = normalize(light.position - fragPos);
 		//diffuse
@@ -116,18 +148,53 @@ vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
 	specular *= attenuation;
 	return (ambient + diffuse + specular);
 }
+#endif
+
+#ifdef POINT_LIGHTS
+PointLight fetchPointLight(int index, out float radius) {
+	vec4 t0 = texelFetch(pointLightData, index * 4);
+	vec4 t1 = texelFetch(pointLightData, index * 4 + 1);
+	vec4 t2 = texelFetch(pointLightData, index * 4 + 2);
+	vec4 t3 = texelFetch(pointLightData, index * 4 + 3);
+	radius = t0.w;
+	return PointLight(t0.xyz, t1.rgb, t2.rgb, t3.rgb, t1.w, t2.w, t3.w);
+}
+
+int clusterIndex() {
+	float depth = -(view * vec4(FragPos, 1.0)).z;
+	int slice = int(log(depth) * clusterDepth.z + clusterDepth.w);
+	ivec3 count = ivec3(clusterCount.xyz);
+	ivec2 tile = ivec2(gl_FragCoord.xy / clusterTile.xy);
+	ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), count - 1);
+	return cluster.x + cluster.y * count.x + cluster.z * count.x * count.y;
+}
+#endif
 
 void main()
 {
 	vec3 viewDir = normalize(viewPos - FragPos);
 	vec3 norm = normalize(Normal);
-	// DirLight
-	vec3 result = calcDirLight(dLight, norm, viewDir);
-	// PointLight
-	for (int i = 0; i < NR_POINT_LIGHTS; i++) {
-		result += calcPointLight(pLights[i], norm, FragPos, viewDir);
+	vec3 result = vec3(0.0);
+#ifdef DIR_LIGHT
+	result += calcDirLight(dLight, norm, viewDir);
+#endif
+#ifdef POINT_LIGHTS
+	// PointLight, only the ones touching this cluster
+	uvec2 range = texelFetch(clusterRanges, clusterIndex()).xy;
+	for (uint i = 0u; i < range.y; i++) {
+		int index = int(texelFetch(clusterLightIndices, int(range.x + i)).x);
+		float radius;
+		PointLight light = fetchPointLight(index, radius);
+		if (distance(light.position, FragPos) < radius)
+			result += calcPointLight(light, norm, FragPos, viewDir);
 	}
+#endif
+#ifdef SPOT_LIGHT
 	result += calcSpotLight(sLight, norm, FragPos, viewDir);
+#endif
+#ifdef MATERIAL_EMISSION
+	result += texture(material.emission, TexCoords).rgb;
+#endif
 
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
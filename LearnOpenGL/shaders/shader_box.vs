@@ -2,10 +2,16 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance model matrix, locations 3-6
+layout (location = 3) in mat4 aModel;
+// per-instance normal matrix computed on the CPU, locations 7-9
+layout (location = 7) in mat3 aNormalMat;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 project;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 project;
+	vec3 viewPos;
+};
 
 out vec3 Normal;
 out vec3 FragPos;
@@ -13,8 +19,8 @@ out vec2 TexCoords;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = aNormalMat * aNormal;
     gl_Position = project * view * vec4(FragPos, 1.0);
 	TexCoords = aTexCoords;
 }
\ No newline at end of file
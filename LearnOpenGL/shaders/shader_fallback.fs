@@ -0,0 +1,11 @@
+#version 330 core
+// stands in for shader_box while it is still compiling: unlit diffuse texture
+uniform sampler2D diffuseMap;
+
+in vec2 TexCoords;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(texture(diffuseMap, TexCoords).rgb * 0.5, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoords;
+// per-instance model matrix, locations 3-6
+layout (location = 3) in mat4 aModel;
+
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 project;
+	vec3 viewPos;
+};
+
+out vec2 TexCoords;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    gl_Position = project * view * aModel * vec4(aPos, 1.0);
+}
@@ -1,11 +1,15 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+// per-instance model matrix, locations 3-6
+layout (location = 3) in mat4 aModel;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 project;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 project;
+	vec3 viewPos;
+};
 
 void main()
 {
-    gl_Position = project * view * model * vec4(aPos, 1.0);
+    gl_Position = project * view * aModel * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,658 @@
+#include "software_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "stb_image.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_SSE 1
+#endif
+
+#define DIFFUSE_TEXTURE_PATH "textures/container_diffuse.png"
+#define SPECULAR_TEXTURE_PATH "textures/container_specular.png"
+#define EMISSION_TEXTURE_PATH "textures/container_emission.jpg"
+
+// what Scene::render sets on the programs every frame
+#define CLEAR_COLOR 0.1f
+#define MATERIAL_SHININESS 32.0f
+#define LIGHT_MARKER_COLOR 1.0f
+#define Z_NEAR 0.1f
+#define Z_FAR 100.0f
+
+#define CUBE_BOUND_RADIUS 0.8660254f
+
+// attribute slots of Triangle::planes
+#define ATTR_INV_W 0
+#define ATTR_UV 1
+#define ATTR_POSITION 3
+#define ATTR_NORMAL 6
+
+typedef std::chrono::high_resolution_clock SoftClock;
+
+static double msSince(SoftClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(SoftClock::now() - start).count();
+}
+
+bool SoftTexture::load(const char* path)
+{
+	int width, height, components;
+	unsigned char* data = stbi_load(path, &width, &height, &components, 0);
+	if (!data)
+	{
+		std::cout << "ERROR::SOFTWARE::TEXTURE_LOAD_FAILED " << path << std::endl;
+		return false;
+	}
+	// expanded the way GL reads GL_RED, GL_RGB and GL_RGBA textures
+	levels.assign(1, Level());
+	Level& base = levels[0];
+	base.width = width;
+	base.height = height;
+	base.texels.resize((size_t)width * height * 4);
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		const unsigned char* in = data + i * components;
+		unsigned char* out = &base.texels[i * 4];
+		out[0] = in[0];
+		out[1] = components >= 3 ? in[1] : 0;
+		out[2] = components >= 3 ? in[2] : 0;
+		out[3] = components == 4 ? in[3] : 255;
+	}
+	stbi_image_free(data);
+
+	// box filtered halves down to 1x1, like glGenerateMipmap
+	while (levels.back().width > 1 || levels.back().height > 1)
+	{
+		const Level& src = levels.back();
+		Level dst;
+		dst.width = std::max(1, src.width / 2);
+		dst.height = std::max(1, src.height / 2);
+		dst.texels.resize((size_t)dst.width * dst.height * 4);
+		for (int y = 0; y < dst.height; y++)
+		{
+			int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+			for (int x = 0; x < dst.width; x++)
+			{
+				int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = src.texels[((size_t)y0 * src.width + x0) * 4 + c] + src.texels[((size_t)y0 * src.width + x1) * 4 + c]
+						+ src.texels[((size_t)y1 * src.width + x0) * 4 + c] + src.texels[((size_t)y1 * src.width + x1) * 4 + c];
+					dst.texels[((size_t)y * dst.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		levels.push_back(std::move(dst));
+	}
+	return true;
+}
+
+static glm::vec3 sampleBilinear(const SoftTexture::Level& level, const glm::vec2& uv)
+{
+	float x = uv.x * level.width - 0.5f;
+	float y = uv.y * level.height - 0.5f;
+	float fx = std::floor(x), fy = std::floor(y);
+	int x0 = (int)fx, y0 = (int)fy;
+	float tx = x - fx, ty = y - fy;
+	// GL_REPEAT, also for negative coordinates
+	auto wrap = [](int i, int size) { i %= size; return i < 0 ? i + size : i; };
+	int xs[2] = { wrap(x0, level.width), wrap(x0 + 1, level.width) };
+	int ys[2] = { wrap(y0, level.height), wrap(y0 + 1, level.height) };
+	glm::vec3 texel[2][2];
+	for (int j = 0; j < 2; j++)
+		for (int i = 0; i < 2; i++)
+		{
+			const unsigned char* t = &level.texels[((size_t)ys[j] * level.width + xs[i]) * 4];
+			texel[j][i] = glm::vec3(t[0], t[1], t[2]);
+		}
+	glm::vec3 top = glm::mix(texel[0][0], texel[0][1], tx);
+	glm::vec3 bottom = glm::mix(texel[1][0], texel[1][1], tx);
+	return glm::mix(top, bottom, ty) * (1.0f / 255.0f);
+}
+
+glm::vec3 SoftTexture::sample(const glm::vec2& uv, float lod) const
+{
+	if (levels.empty())
+		return glm::vec3(0.0f);
+	// magnification and the base level: GL_LINEAR
+	if (!(lod > 0.0f))
+		return sampleBilinear(levels[0], uv);
+	float maxLevel = (float)(levels.size() - 1);
+	lod = std::min(lod, maxLevel);
+	int level = (int)lod;
+	float t = lod - level;
+	glm::vec3 a = sampleBilinear(levels[level], uv);
+	if (t == 0.0f || level + 1 >= (int)levels.size())
+		return a;
+	return glm::mix(a, sampleBilinear(levels[level + 1], uv), t);
+}
+
+SoftwareRenderer::SoftwareRenderer(int width, int height, ThreadPool& pool, unsigned int features)
+	: width_(width),
+	  height_(height),
+	  tilesX_((width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE),
+	  tilesY_((height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE),
+	  pool_(pool),
+	  features_(features),
+	  lightsBlock_(Scene::defaultLights()),
+	  stride_(tilesX_ * SOFT_TILE_SIZE),
+	  stats_()
+{
+	diffuse_.load(DIFFUSE_TEXTURE_PATH);
+	specular_.load(SPECULAR_TEXTURE_PATH);
+	emission_.load(EMISSION_TEXTURE_PATH);
+	cube_ = Scene::cubeVertexData(cubeVertices_);
+
+	size_t padded = (size_t)stride_ * tilesY_ * SOFT_TILE_SIZE;
+	depth_.resize(padded);
+	visible_.resize(padded);
+	pixels_.resize((size_t)width_ * height_ * 3);
+	for (Chunk& chunk : chunks_)
+		chunk.bins.resize((size_t)tilesX_ * tilesY_);
+
+	setBoxInstances(Scene::defaultBoxInstances());
+	setPointLights(Scene::defaultPointLights());
+}
+
+void SoftwareRenderer::setBoxInstances(const std::vector<glm::mat4>& models)
+{
+	boxes_.resize(models.size());
+	for (size_t i = 0; i < models.size(); i++)
+		boxes_[i].model = models[i];
+	computeNormalMatrices(boxes_.data(), boxes_.size());
+}
+
+void SoftwareRenderer::setPointLights(const std::vector<PointLight>& lights)
+{
+	lights_ = lights;
+	lightRadii_.clear();
+	markers_.clear();
+	for (const PointLight& light : lights_)
+	{
+		lightRadii_.push_back(pointLightRadius(light));
+		InstanceData marker;
+		marker.model = glm::scale(glm::translate(glm::mat4(1.0f), light.position), glm::vec3(0.1f));
+		marker.normal = glm::mat3(1.0f);
+		markers_.push_back(marker);
+	}
+}
+
+void SoftwareRenderer::render(Camera& cam)
+{
+	auto start = SoftClock::now();
+	glm::mat4 project = glm::perspective(glm::radians(cam.getFovY()), (float)width_ / (float)height_, Z_NEAR, Z_FAR);
+	viewProject_ = project * cam.getViewMat();
+	viewPos_ = cam.getCamPos();
+	frustum_ = extractFrustum(viewProject_);
+	lightsBlock_.sLight.position = cam.getCamPos();
+	lightsBlock_.sLight.direction = cam.getCamFront();
+
+	// light markers first, then the boxes, the order Scene draws them in
+	size_t instances = (features_ & FEATURE_POINT_LIGHTS ? markers_.size() : 0) + boxes_.size();
+	size_t perChunk = (instances + SOFT_SETUP_CHUNKS - 1) / SOFT_SETUP_CHUNKS;
+	pool_.parallelFor(SOFT_SETUP_CHUNKS, 1, [this, instances, perChunk](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; c++)
+			setupChunk(chunks_[c], std::min(instances, c * perChunk), std::min(instances, (c + 1) * perChunk));
+	});
+	auto setupEnd = SoftClock::now();
+
+	stats_ = Stats();
+	stats_.instances = instances;
+	for (const Chunk& chunk : chunks_)
+	{
+		stats_.triangles += chunk.triangles.size() + chunk.culled;
+		stats_.culled += chunk.culled;
+		for (const std::vector<unsigned int>& bin : chunk.bins)
+			stats_.binned += bin.size();
+	}
+
+	pool_.parallelFor((size_t)tilesX_ * tilesY_, 1, [this](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; tile++)
+			rasterTile((int)tile);
+	});
+	for (int y = 0; y < height_; y++)
+		for (int x = 0; x < width_; x++)
+			stats_.shadedPixels += visible_[(size_t)y * stride_ + x] != nullptr;
+	stats_.setupMs = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+	stats_.rasterMs = msSince(setupEnd);
+}
+
+void SoftwareRenderer::setupChunk(Chunk& chunk, size_t begin, size_t end)
+{
+	chunk.triangles.clear();
+	chunk.culled = 0;
+	for (std::vector<unsigned int>& bin : chunk.bins)
+		bin.clear();
+	size_t markerCount = features_ & FEATURE_POINT_LIGHTS ? markers_.size() : 0;
+	for (size_t i = begin; i < end; i++)
+	{
+		bool marker = i < markerCount;
+		const InstanceData& instance = marker ? markers_[i] : boxes_[i - markerCount];
+		const glm::mat4& model = instance.model;
+		// whole instances outside the frustum never reach the triangles
+		float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		glm::vec4 center = model[3];
+		bool outside = false;
+		for (const glm::vec4& plane : frustum_.planes)
+			outside |= glm::dot(plane, center) < -CUBE_BOUND_RADIUS * scale;
+		if (outside)
+		{
+			chunk.culled += cubeVertices_ / 3;
+			continue;
+		}
+
+		glm::mat4 mvp = viewProject_ * model;
+		for (size_t v = 0; v < cubeVertices_; v += 3)
+		{
+			glm::vec4 clip[3];
+			glm::vec3 attributes[3][3];
+			for (int k = 0; k < 3; k++)
+			{
+				const float* in = cube_ + (v + k) * 8;
+				glm::vec4 position(in[0], in[1], in[2], 1.0f);
+				clip[k] = mvp * position;
+				attributes[k][0] = glm::vec3(model * position);
+				attributes[k][1] = instance.normal * glm::vec3(in[3], in[4], in[5]);
+				attributes[k][2] = glm::vec3(in[6], in[7], 0.0f);
+			}
+			// faces turned away from the eye are hidden behind the front of the closed cube
+			if (glm::dot(attributes[0][1], viewPos_ - attributes[0][0]) <= 0.0f)
+			{
+				chunk.culled++;
+				continue;
+			}
+			setupTriangle(chunk, clip, attributes, marker);
+		}
+	}
+}
+
+// clip against the near and far planes, the screen edges are handled by the tile bounds
+void SoftwareRenderer::setupTriangle(Chunk& chunk, const glm::vec4 clip[3], const glm::vec3 attributes[3][3], bool marker)
+{
+	// all three vertices beyond one plane of the clip volume
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w)
+		{
+			chunk.culled++;
+			return;
+		}
+		if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w)
+		{
+			chunk.culled++;
+			return;
+		}
+	}
+	bool inside = true;
+	for (int k = 0; k < 3; k++)
+		inside &= clip[k].z >= -clip[k].w && clip[k].z <= clip[k].w;
+	if (inside)
+	{
+		emitTriangle(chunk, clip, attributes, marker);
+		return;
+	}
+
+	// Sutherland-Hodgman, a triangle gains at most one vertex per plane
+	glm::vec4 polygon[5], next[5];
+	glm::vec3 polygonAttributes[5][3], nextAttributes[5][3];
+	int count = 3;
+	for (int k = 0; k < 3; k++)
+	{
+		polygon[k] = clip[k];
+		for (int a = 0; a < 3; a++)
+			polygonAttributes[k][a] = attributes[k][a];
+	}
+	for (int side = 0; side < 2; side++)
+	{
+		// signed distance to z = -w, then to z = w
+		auto distance = [side](const glm::vec4& v) { return side == 0 ? v.z + v.w : v.w - v.z; };
+		int nextCount = 0;
+		for (int k = 0; k < count; k++)
+		{
+			int j = (k + 1) % count;
+			float dk = distance(polygon[k]), dj = distance(polygon[j]);
+			if (dk >= 0.0f)
+			{
+				next[nextCount] = polygon[k];
+				for (int a = 0; a < 3; a++)
+					nextAttributes[nextCount][a] = polygonAttributes[k][a];
+				nextCount++;
+			}
+			if ((dk >= 0.0f) != (dj >= 0.0f))
+			{
+				float t = dk / (dk - dj);
+				next[nextCount] = polygon[k] + (polygon[j] - polygon[k]) * t;
+				for (int a = 0; a < 3; a++)
+					nextAttributes[nextCount][a] = glm::mix(polygonAttributes[k][a], polygonAttributes[j][a], t);
+				nextCount++;
+			}
+		}
+		count = nextCount;
+		std::copy(next, next + count, polygon);
+		for (int k = 0; k < count; k++)
+			for (int a = 0; a < 3; a++)
+				polygonAttributes[k][a] = nextAttributes[k][a];
+	}
+	if (count < 3)
+	{
+		chunk.culled++;
+		return;
+	}
+	for (int k = 1; k + 1 < count; k++)
+	{
+		glm::vec4 fan[3] = { polygon[0], polygon[k], polygon[k + 1] };
+		glm::vec3 fanAttributes[3][3];
+		for (int a = 0; a < 3; a++)
+		{
+			fanAttributes[0][a] = polygonAttributes[0][a];
+			fanAttributes[1][a] = polygonAttributes[k][a];
+			fanAttributes[2][a] = polygonAttributes[k + 1][a];
+		}
+		emitTriangle(chunk, fan, fanAttributes, marker);
+	}
+}
+
+void SoftwareRenderer::emitTriangle(Chunk& chunk, const glm::vec4 clip[3], const glm::vec3 attributes[3][3], bool marker)
+{
+	// window coordinates with the top row first
+	glm::vec2 screen[3];
+	float depth[3], invW[3];
+	for (int k = 0; k < 3; k++)
+	{
+		invW[k] = 1.0f / clip[k].w;
+		screen[k] = glm::vec2((clip[k].x * invW[k] * 0.5f + 0.5f) * width_, (0.5f - clip[k].y * invW[k] * 0.5f) * height_);
+		depth[k] = clip[k].z * invW[k] * 0.5f + 0.5f;
+	}
+	float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+	// both windings are drawn, flip the clockwise ones so the edge functions are positive inside
+	int order[3] = { 0, 1, 2 };
+	if (area < 0.0f)
+	{
+		std::swap(order[1], order[2]);
+		area = -area;
+	}
+	if (!(area > 1e-8f))
+	{
+		chunk.culled++;
+		return;
+	}
+
+	Triangle tri;
+	tri.marker = marker;
+	float minX = (float)width_, minY = (float)height_, maxX = 0.0f, maxY = 0.0f;
+	for (int k = 0; k < 3; k++)
+	{
+		const glm::vec2& a = screen[order[(k + 1) % 3]];
+		const glm::vec2& b = screen[order[(k + 2) % 3]];
+		tri.edgeA[k] = a.y - b.y;
+		tri.edgeB[k] = b.x - a.x;
+		tri.edgeC[k] = -(tri.edgeA[k] * a.x + tri.edgeB[k] * a.y);
+		tri.topLeft[k] = tri.edgeA[k] > 0.0f || (tri.edgeA[k] == 0.0f && tri.edgeB[k] > 0.0f);
+		minX = std::min(minX, screen[k].x);
+		minY = std::min(minY, screen[k].y);
+		maxX = std::max(maxX, screen[k].x);
+		maxY = std::max(maxY, screen[k].y);
+	}
+	// pixel centers sit at +0.5
+	tri.minX = std::max(0, (int)std::floor(minX - 0.5f));
+	tri.minY = std::max(0, (int)std::floor(minY - 0.5f));
+	tri.maxX = std::min(width_ - 1, (int)std::ceil(maxX - 0.5f));
+	tri.maxY = std::min(height_ - 1, (int)std::ceil(maxY - 0.5f));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+	{
+		chunk.culled++;
+		return;
+	}
+
+	// a value at each vertex becomes the plane through them: sum of edge function * value / area
+	float invArea = 1.0f / area;
+	auto plane = [&](const float values[3], float out[3]) {
+		out[0] = out[1] = out[2] = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			float value = values[order[k]] * invArea;
+			out[0] += tri.edgeA[k] * value;
+			out[1] += tri.edgeB[k] * value;
+			out[2] += tri.edgeC[k] * value;
+		}
+	};
+	float depthPlane[3];
+	plane(depth, depthPlane);
+	tri.depthA = depthPlane[0];
+	tri.depthB = depthPlane[1];
+	tri.depthC = depthPlane[2];
+	plane(invW, tri.planes[ATTR_INV_W]);
+	if (!marker)
+	{
+		for (int c = 0; c < 2; c++)
+		{
+			float values[3] = { attributes[0][2][c] * invW[0], attributes[1][2][c] * invW[1], attributes[2][2][c] * invW[2] };
+			plane(values, tri.planes[ATTR_UV + c]);
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			float position[3] = { attributes[0][0][c] * invW[0], attributes[1][0][c] * invW[1], attributes[2][0][c] * invW[2] };
+			plane(position, tri.planes[ATTR_POSITION + c]);
+			float normal[3] = { attributes[0][1][c] * invW[0], attributes[1][1][c] * invW[1], attributes[2][1][c] * invW[2] };
+			plane(normal, tri.planes[ATTR_NORMAL + c]);
+		}
+	}
+
+	unsigned int index = (unsigned int)chunk.triangles.size();
+	chunk.triangles.push_back(tri);
+	for (int ty = tri.minY / SOFT_TILE_SIZE; ty <= tri.maxY / SOFT_TILE_SIZE; ty++)
+		for (int tx = tri.minX / SOFT_TILE_SIZE; tx <= tri.maxX / SOFT_TILE_SIZE; tx++)
+			chunk.bins[(size_t)ty * tilesX_ + tx].push_back(index);
+}
+
+void SoftwareRenderer::rasterTile(int tile)
+{
+	int tileX0 = (tile % tilesX_) * SOFT_TILE_SIZE;
+	int tileY0 = (tile / tilesX_) * SOFT_TILE_SIZE;
+	int tileX1 = std::min(tileX0 + SOFT_TILE_SIZE, width_);
+	int tileY1 = std::min(tileY0 + SOFT_TILE_SIZE, height_);
+	for (int y = tileY0; y < tileY0 + SOFT_TILE_SIZE; y++)
+	{
+		std::fill_n(&depth_[(size_t)y * stride_ + tileX0], SOFT_TILE_SIZE, 1.0f);
+		std::fill_n(&visible_[(size_t)y * stride_ + tileX0], SOFT_TILE_SIZE, nullptr);
+	}
+
+	// chunk by chunk keeps the submission order, equal depths resolve the way GL_LESS does
+	for (const Chunk& chunk : chunks_)
+	{
+		for (unsigned int index : chunk.bins[tile])
+		{
+			const Triangle& tri = chunk.triangles[index];
+			int x0 = std::max(tri.minX, tileX0), x1 = std::min(tri.maxX + 1, tileX1);
+			int y0 = std::max(tri.minY, tileY0), y1 = std::min(tri.maxY + 1, tileY1);
+			// four pixel steps, starting on a multiple of four so the loads stay inside the padded row
+			x0 &= ~3;
+#ifdef SOFTWARE_SSE
+			const __m128 laneX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			const __m128 zero = _mm_setzero_ps();
+			__m128 edgeA[3], topLeft[3];
+			for (int k = 0; k < 3; k++)
+			{
+				edgeA[k] = _mm_set1_ps(tri.edgeA[k]);
+				topLeft[k] = _mm_castsi128_ps(_mm_set1_epi32(tri.topLeft[k] ? -1 : 0));
+			}
+			__m128 depthA = _mm_set1_ps(tri.depthA);
+			for (int y = y0; y < y1; y++)
+			{
+				float py = y + 0.5f;
+				__m128 edgeRow[3];
+				for (int k = 0; k < 3; k++)
+					edgeRow[k] = _mm_set1_ps(tri.edgeB[k] * py + tri.edgeC[k]);
+				__m128 depthRow = _mm_set1_ps(tri.depthB * py + tri.depthC);
+				float* depthLine = &depth_[(size_t)y * stride_];
+				const Triangle** visibleLine = &visible_[(size_t)y * stride_];
+				for (int x = x0; x < x1; x += 4)
+				{
+					__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneX);
+					__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+					for (int k = 0; k < 3; k++)
+					{
+						__m128 e = _mm_add_ps(_mm_mul_ps(edgeA[k], px), edgeRow[k]);
+						__m128 covered = _mm_or_ps(_mm_cmpgt_ps(e, zero), _mm_and_ps(topLeft[k], _mm_cmpeq_ps(e, zero)));
+						inside = _mm_and_ps(inside, covered);
+					}
+					__m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), depthRow);
+					__m128 stored = _mm_loadu_ps(depthLine + x);
+					// zero to one, the same depth range GL clips to
+					__m128 pass = _mm_and_ps(inside, _mm_and_ps(_mm_cmplt_ps(z, stored), _mm_cmpge_ps(z, zero)));
+					int bits = _mm_movemask_ps(pass);
+					if (!bits)
+						continue;
+					_mm_storeu_ps(depthLine + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, stored)));
+					for (int lane = 0; lane < 4; lane++)
+						if (bits & (1 << lane))
+							visibleLine[x + lane] = &tri;
+				}
+			}
+#else
+			for (int y = y0; y < y1; y++)
+			{
+				float py = y + 0.5f;
+				for (int x = x0; x < x1; x++)
+				{
+					float px = x + 0.5f;
+					bool inside = true;
+					for (int k = 0; k < 3; k++)
+					{
+						float e = tri.edgeA[k] * px + tri.edgeB[k] * py + tri.edgeC[k];
+						inside &= e > 0.0f || (e == 0.0f && tri.topLeft[k]);
+					}
+					float z = tri.depthA * px + tri.depthB * py + tri.depthC;
+					size_t pixel = (size_t)y * stride_ + x;
+					if (inside && z >= 0.0f && z < depth_[pixel])
+					{
+						depth_[pixel] = z;
+						visible_[pixel] = &tri;
+					}
+				}
+			}
+#endif
+		}
+	}
+
+	// every visible pixel is shaded once
+	const unsigned char clear = (unsigned char)(CLEAR_COLOR * 255.0f + 0.5f);
+	for (int y = tileY0; y < tileY1; y++)
+	{
+		for (int x = tileX0; x < tileX1; x++)
+		{
+			const Triangle* tri = visible_[(size_t)y * stride_ + x];
+			unsigned char* out = &pixels_[((size_t)y * width_ + x) * 3];
+			if (!tri)
+			{
+				out[0] = out[1] = out[2] = clear;
+				continue;
+			}
+			glm::vec3 color = tri->marker ? glm::vec3(LIGHT_MARKER_COLOR) : shade(*tri, x + 0.5f, y + 0.5f);
+			for (int c = 0; c < 3; c++)
+				out[c] = (unsigned char)(glm::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+static inline float evaluate(const float plane[3], float x, float y)
+{
+	return plane[0] * x + plane[1] * y + plane[2];
+}
+
+static float attenuation(float constant, float linear, float quadratic, float distance)
+{
+	return 1.0f / (constant + linear * distance + quadratic * (distance * distance));
+}
+
+// shader_box.fs for one pixel
+glm::vec3 SoftwareRenderer::shade(const Triangle& tri, float x, float y) const
+{
+	float invW = evaluate(tri.planes[ATTR_INV_W], x, y);
+	float w = 1.0f / invW;
+	glm::vec2 uv(evaluate(tri.planes[ATTR_UV], x, y) * w, evaluate(tri.planes[ATTR_UV + 1], x, y) * w);
+	glm::vec3 fragPos, normal;
+	for (int c = 0; c < 3; c++)
+	{
+		fragPos[c] = evaluate(tri.planes[ATTR_POSITION + c], x, y) * w;
+		normal[c] = evaluate(tri.planes[ATTR_NORMAL + c], x, y) * w;
+	}
+
+	// screen derivatives of u = (u/w) / (1/w), the quotient rule on the two planes
+	glm::vec2 dx, dy;
+	for (int c = 0; c < 2; c++)
+	{
+		float value = uv[c] * invW;
+		dx[c] = (tri.planes[ATTR_UV + c][0] * invW - value * tri.planes[ATTR_INV_W][0]) * w * w;
+		dy[c] = (tri.planes[ATTR_UV + c][1] * invW - value * tri.planes[ATTR_INV_W][1]) * w * w;
+	}
+	auto lodOf = [&dx, &dy](const SoftTexture& texture) {
+		if (texture.levels.empty())
+			return 0.0f;
+		float width = (float)texture.levels[0].width, height = (float)texture.levels[0].height;
+		float rho = std::max(glm::length(glm::vec2(dx.x * width, dx.y * height)), glm::length(glm::vec2(dy.x * width, dy.y * height)));
+		return std::log2(rho);
+	};
+	glm::vec3 diffuseColor = diffuse_.sample(uv, lodOf(diffuse_));
+	glm::vec3 specularColor = specular_.sample(uv, lodOf(specular_));
+
+	glm::vec3 viewDir = glm::normalize(viewPos_ - fragPos);
+	glm::vec3 norm = glm::normalize(normal);
+	glm::vec3 result(0.0f);
+	if (features_ & FEATURE_DIR_LIGHT)
+	{
+		const DirLightStd140& light = lightsBlock_.dLight;
+		glm::vec3 lightDir = glm::normalize(-light.direction);
+		float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+		float spec = std::pow(std::max(glm::dot(viewDir, glm::reflect(-lightDir, norm)), 0.0f), MATERIAL_SHININESS);
+		result += light.ambient * diffuseColor + light.diffuse * diff * diffuseColor + light.specular * spec * specularColor;
+	}
+	if (features_ & FEATURE_POINT_LIGHTS)
+	{
+		for (size_t i = 0; i < lights_.size(); i++)
+		{
+			const PointLight& light = lights_[i];
+			float distance = glm::length(light.position - fragPos);
+			if (!(distance < lightRadii_[i]))
+				continue;
+			glm::vec3 lightDir = glm::normalize(light.position - fragPos);
+			float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+			float spec = std::pow(std::max(glm::dot(viewDir, glm::reflect(-lightDir, norm)), 0.0f), MATERIAL_SHININESS);
+			float att = attenuation(light.constant, light.linear, light.quadratic, distance);
+			result += (light.ambient * diffuseColor + light.diffuse * diff * diffuseColor + light.specular * spec * specularColor) * att;
+		}
+	}
+	if (features_ & FEATURE_SPOT_LIGHT)
+	{
+		const SpotLightStd140& light = lightsBlock_.sLight;
+		glm::vec3 lightDir = glm::normalize(light.position - fragPos);
+		float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+		float spec = std::pow(std::max(glm::dot(viewDir, glm::reflect(-lightDir, norm)), 0.0f), MATERIAL_SHININESS);
+		float theta = glm::dot(lightDir, glm::normalize(-light.direction));
+		float intensity = glm::clamp((theta - light.cutoff) / (light.cutoff - light.outerCutoff), 0.0f, 1.0f);
+		float att = attenuation(light.constant, light.linear, light.quadratic, glm::length(light.position - fragPos));
+		result += (light.ambient * diffuseColor + (light.diffuse * diff * diffuseColor + light.specular * spec * specularColor) * intensity) * att;
+	}
+	if (features_ & FEATURE_EMISSION)
+		result += emission_.sample(uv, lodOf(emission_));
+	return result;
+}
+
+bool SoftwareRenderer::saveFrame(const char* path) const
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		std::cout << "Failed to write frame: " << path << std::endl;
+		return false;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", width_, height_);
+	fwrite(pixels_.data(), 1, pixels_.size(), file);
+	fclose(file);
+	return true;
+}
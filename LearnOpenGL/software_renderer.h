@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "clusters.h"
+#include "scene.h"
+#include "thread_pool.h"
+#include "transform.h"
+
+// the screen is rasterized in square tiles of this many pixels, one task each
+#define SOFT_TILE_SIZE 64
+// instances are split into this many setup chunks whatever the thread count,
+// so the triangle order and with it every frame is the same on any machine
+#define SOFT_SETUP_CHUNKS 64
+// 1/w, u/w, v/w, world position / w, normal / w
+#define SOFT_ATTRIBUTES 9
+
+// RGBA8 image with its box filtered mip chain, sampled like a GL_REPEAT,
+// GL_LINEAR_MIPMAP_LINEAR texture
+struct SoftTexture
+{
+	struct Level
+	{
+		int width;
+		int height;
+		std::vector<unsigned char> texels;
+	};
+	std::vector<Level> levels;
+
+	bool load(const char* path);
+	// lod is log2 of texels per pixel
+	glm::vec3 sample(const glm::vec2& uv, float lod) const;
+};
+
+// CPU implementation of Scene::render for machines without a GPU or any GL
+// driver: the same boxes, light markers, lights and lighting features, drawn
+// with the shader_box.fs lighting into an RGB8 frame. Vertices are
+// transformed, clipped and set up in parallel chunks that bin their triangles
+// into screen tiles; each tile then rasterizes its bins with SSE into a depth
+// and visibility buffer and shades every visible pixel once, perspective
+// correct. Needs no GL context.
+class SoftwareRenderer
+{
+public:
+	struct Stats
+	{
+		size_t instances;
+		size_t triangles;
+		// back facing, outside the frustum or without pixels
+		size_t culled;
+		// triangles references over all tiles
+		size_t binned;
+		size_t shadedPixels;
+		double setupMs;
+		double rasterMs;
+	};
+
+	SoftwareRenderer(int width, int height, ThreadPool& pool, unsigned int features = FEATURE_DEFAULT);
+
+	SoftwareRenderer(const SoftwareRenderer&) = delete;
+	SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
+
+	void render(Camera& cam);
+
+	void setBoxInstances(const std::vector<glm::mat4>& models);
+	void setPointLights(const std::vector<PointLight>& lights);
+	void setFeatures(unsigned int features) { features_ = features; }
+
+	int getWidth() const { return width_; }
+	int getHeight() const { return height_; }
+	// RGB rows, top row first
+	const std::vector<unsigned char>& getPixels() const { return pixels_; }
+	bool saveFrame(const char* path) const;
+	const Stats& getStats() const { return stats_; }
+
+private:
+	struct Triangle
+	{
+		// edge functions a * x + b * y + c, positive inside; top-left edges also own their zeros
+		float edgeA[3], edgeB[3], edgeC[3];
+		bool topLeft[3];
+		// window depth, linear in screen space
+		float depthA, depthB, depthC;
+		// attribute / w, linear in screen space
+		float planes[SOFT_ATTRIBUTES][3];
+		int minX, minY, maxX, maxY;
+		bool marker;
+	};
+
+	struct Chunk
+	{
+		std::vector<Triangle> triangles;
+		// triangle indices per tile
+		std::vector<std::vector<unsigned int>> bins;
+		size_t culled;
+	};
+
+	void setupChunk(Chunk& chunk, size_t begin, size_t end);
+	void setupTriangle(Chunk& chunk, const glm::vec4 clip[3], const glm::vec3 attributes[3][3], bool marker);
+	void emitTriangle(Chunk& chunk, const glm::vec4 clip[3], const glm::vec3 attributes[3][3], bool marker);
+	void rasterTile(int tile);
+	glm::vec3 shade(const Triangle& tri, float x, float y) const;
+
+	int width_;
+	int height_;
+	int tilesX_;
+	int tilesY_;
+	ThreadPool& pool_;
+	unsigned int features_;
+
+	SoftTexture diffuse_;
+	SoftTexture specular_;
+	SoftTexture emission_;
+	// position, normal, uv of the 36 cube vertices
+	const float* cube_;
+	size_t cubeVertices_;
+
+	std::vector<InstanceData> boxes_;
+	std::vector<InstanceData> markers_;
+	std::vector<PointLight> lights_;
+	std::vector<float> lightRadii_;
+	LightsBlock lightsBlock_;
+
+	// per frame
+	glm::mat4 viewProject_;
+	glm::vec3 viewPos_;
+	Frustum frustum_;
+	Chunk chunks_[SOFT_SETUP_CHUNKS];
+
+	// tile aligned, row y of the window at index y * stride
+	int stride_;
+	std::vector<float> depth_;
+	std::vector<const Triangle*> visible_;
+	std::vector<unsigned char> pixels_;
+	Stats stats_;
+};
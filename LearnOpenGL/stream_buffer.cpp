@@ -0,0 +1,178 @@
+#include "stream_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "gl_ext.h"
+
+// a region that has to grow rounds up to a multiple of this
+#define STREAM_GROW_GRANULARITY (64 << 10)
+
+StreamBuffer::StreamBuffer(size_t frameBytes)
+	: persistent_(GLExt::hasBufferStorage),
+	  buffer_(0),
+	  mapped_(nullptr),
+	  rangeMapped_(false),
+	  regionBytes_(0),
+	  uniformAlignment_(256),
+	  region_(0),
+	  head_(0),
+	  frame_(0),
+	  fencePending_(false),
+	  stats_()
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0)
+		uniformAlignment_ = (size_t)alignment;
+	for (GLsync& fence : fences_)
+		fence = nullptr;
+	create(frameBytes);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	deleteFences();
+	// deleting a mapped buffer unmaps it
+	glDeleteBuffers(1, &buffer_);
+	for (const Retired& retired : retired_)
+		glDeleteBuffers(1, &retired.buffer);
+}
+
+void StreamBuffer::create(size_t regionBytes)
+{
+	regionBytes_ = regionBytes;
+	stats_.regionBytes = regionBytes;
+	GLsizeiptr size = (GLsizeiptr)(regionBytes * STREAM_FRAMES);
+	glGenBuffers(1, &buffer_);
+	// a target nothing else binds, so no vertex or uniform binding is disturbed
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+	if (persistent_)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLExt::bufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		mapped_ = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		if (!mapped_)
+		{
+			std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED, mapping every allocation instead" << std::endl;
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, &buffer_);
+			persistent_ = false;
+			create(regionBytes);
+			return;
+		}
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		mapped_ = nullptr;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::deleteFences()
+{
+	for (GLsync& fence : fences_)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+void StreamBuffer::beginFrame()
+{
+	// fenced only now: creating a fence flushes on some drivers, and by the
+	// next frame the swap has submitted everything already
+	if (fencePending_)
+	{
+		if (fences_[region_])
+			glDeleteSync(fences_[region_]);
+		fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		fencePending_ = false;
+	}
+	frame_++;
+	region_ = (int)(frame_ % STREAM_FRAMES);
+	head_ = 0;
+
+	// whatever drew from a retired buffer was fenced a full ring ago
+	size_t kept = 0;
+	for (const Retired& retired : retired_)
+	{
+		if (retired.frame + STREAM_FRAMES <= frame_)
+			glDeleteBuffers(1, &retired.buffer);
+		else
+			retired_[kept++] = retired;
+	}
+	retired_.resize(kept);
+
+	GLsync& fence = fences_[region_];
+	if (!fence)
+		return;
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		stats_.waits++;
+		auto start = std::chrono::high_resolution_clock::now();
+		do
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		while (status == GL_TIMEOUT_EXPIRED);
+		stats_.waitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void StreamBuffer::grow(size_t bytes)
+{
+	retired_.push_back({ buffer_, frame_ });
+	// the fences guard the old buffer, the new one has nothing in flight
+	deleteFences();
+	size_t regionBytes = std::max(regionBytes_ * 2, bytes);
+	regionBytes = (regionBytes + STREAM_GROW_GRANULARITY - 1) / STREAM_GROW_GRANULARITY * STREAM_GROW_GRANULARITY;
+	create(regionBytes);
+	stats_.grows++;
+	head_ = 0;
+}
+
+void* StreamBuffer::map(size_t bytes, size_t alignment, GLintptr& offset)
+{
+	// aligned within the whole buffer, so offset / alignment indexes it
+	size_t base = region_ * regionBytes_;
+	size_t start = (base + head_ + alignment - 1) / alignment * alignment - base;
+	if (start + bytes > regionBytes_)
+	{
+		grow(bytes + alignment);
+		base = region_ * regionBytes_;
+		start = (base + alignment - 1) / alignment * alignment - base;
+	}
+	head_ = start + bytes;
+	offset = (GLintptr)(base + start);
+	if (persistent_)
+		return mapped_ + offset;
+	if (bytes == 0)
+		return nullptr;
+	// the fences already keep the GPU off this range
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+	void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, (GLsizeiptr)bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	rangeMapped_ = true;
+	return data;
+}
+
+void StreamBuffer::unmap()
+{
+	// coherent persistent writes need no flush
+	if (!rangeMapped_)
+		return;
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	rangeMapped_ = false;
+}
+
+void StreamBuffer::endFrame()
+{
+	fencePending_ = true;
+	stats_.frameBytes = head_;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+// frames the CPU may run ahead of the GPU, one region of the ring each
+#define STREAM_FRAMES 3
+// region size until a frame needs more
+#define STREAM_DEFAULT_FRAME_BYTES (1 << 20)
+
+// Ring allocator for data written every frame: instance transforms, uniform
+// blocks. One buffer holds STREAM_FRAMES regions; frame n writes region
+// n % STREAM_FRAMES and fences it when submitted, and the next frame on that
+// region waits for the fence first, so the CPU never writes what the GPU still
+// reads and the driver never has to copy or synchronize behind our back. With
+// buffer storage the buffer is mapped once, persistent and coherent, and
+// allocations are plain pointers into it; without, every allocation maps its
+// range unsynchronized. A frame that outgrows its region moves the ring to a
+// buffer twice the size; the old one lives until the GPU is done with it.
+// Requires a current GL context for its whole lifetime.
+class StreamBuffer
+{
+public:
+	struct Stats
+	{
+		// allocated by the last finished frame
+		size_t frameBytes;
+		size_t regionBytes;
+		// frames whose region was still in use by the GPU, and the time spent waiting
+		unsigned int waits;
+		double waitMs;
+		unsigned int grows;
+	};
+
+	explicit StreamBuffer(size_t frameBytes = STREAM_DEFAULT_FRAME_BYTES);
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// move to the next region, waiting for the GPU if it still reads it
+	void beginFrame();
+	// bytes in this frame's region at offset in getBuffer() as it is after
+	// the call; write them, then unmap() before the next map() or any draw.
+	// Valid until the same region comes round again. offset is a multiple of
+	// alignment, which may be a struct size so offset / size indexes the buffer.
+	void* map(size_t bytes, size_t alignment, GLintptr& offset);
+	void unmap();
+	// call after the frame's last draw; its region is fenced when the next
+	// frame begins, which covers the swap as well
+	void endFrame();
+
+	GLuint getBuffer() const { return buffer_; }
+	bool isPersistent() const { return persistent_; }
+	// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, for map()s bound with glBindBufferRange
+	size_t getUniformAlignment() const { return uniformAlignment_; }
+	const Stats& getStats() const { return stats_; }
+
+private:
+	void create(size_t regionBytes);
+	void grow(size_t bytes);
+	void deleteFences();
+
+	// buffers the ring moved away from, deleted once the frame count passes frame
+	struct Retired
+	{
+		GLuint buffer;
+		unsigned long long frame;
+	};
+
+	bool persistent_;
+	GLuint buffer_;
+	unsigned char* mapped_;
+	bool rangeMapped_;
+	size_t regionBytes_;
+	size_t uniformAlignment_;
+	GLsync fences_[STREAM_FRAMES];
+	int region_;
+	size_t head_;
+	unsigned long long frame_;
+	bool fencePending_;
+	std::vector<Retired> retired_;
+	Stats stats_;
+};
@@ -0,0 +1,204 @@
+#include "texture.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+static GLenum formatOf(int components)
+{
+	if (components == 1)
+		return GL_RED;
+	if (components == 3)
+		return GL_RGB;
+	return GL_RGBA;
+}
+
+// texture bound to GL_TEXTURE_2D gets mipmaps and the repeat/trilinear sampling every material uses
+static void finishMipmappedTexture()
+{
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+unsigned int loadTexture(char const * path)
+{
+	unsigned int textureId;
+	glGenTextures(1, &textureId);
+
+	int width, height, nrComponents;
+	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+	if (data)
+	{
+		GLenum format = formatOf(nrComponents);
+		GLState::bindTexture(0, GL_TEXTURE_2D, textureId);
+		// rows of 1 and 3 channel images are not 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		finishMipmappedTexture();
+
+		stbi_image_free(data);
+	}
+	else
+	{
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		stbi_image_free(data);
+	}
+
+	return textureId;
+}
+
+TextureLoader::TextureLoader(ThreadPool& pool, bool usePbo)
+	: pool_(pool), usePbo_(usePbo), pbo_(0), pboBytes_(0), decoding_(0), decodeMs_(0.0), stats_()
+{
+	if (usePbo_)
+		glGenBuffers(1, &pbo_);
+}
+
+TextureLoader::~TextureLoader()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	decoded_.wait(lock, [this] { return decoding_ == 0; });
+	for (DecodedImage& image : ready_)
+		stbi_image_free(image.pixels);
+	if (pbo_)
+		glDeleteBuffers(1, &pbo_);
+}
+
+unsigned int TextureLoader::load(const char* path)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	// no mipmaps yet, a mipmap filter would leave the placeholder incomplete
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+	reload(texture, path);
+	return texture;
+}
+
+void TextureLoader::reload(unsigned int texture, const char* path)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		decoding_++;
+	}
+	stats_.requested++;
+	std::string file = path;
+	pool_.submit([this, texture, file]() { decode(texture, file); });
+}
+
+// worker thread: stb_image keeps no shared state as long as nobody flips or changes its globals
+void TextureLoader::decode(unsigned int texture, const std::string& path)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	DecodedImage image;
+	image.texture = texture;
+	image.path = path;
+	image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	ready_.push_back(image);
+	decodeMs_ += ms;
+	decoding_--;
+	decoded_.notify_all();
+}
+
+void TextureLoader::upload(const DecodedImage& image)
+{
+	if (!image.pixels) {
+		std::cout << "Texture failed to load at path: " << image.path << std::endl;
+		stats_.failed++;
+		return;
+	}
+
+	size_t bytes = (size_t)image.width * image.height * image.components;
+	GLenum format = formatOf(image.components);
+	const void* source = image.pixels;
+	bool throughPbo = false;
+	if (usePbo_) {
+		// orphan the previous contents, the driver may still be reading them
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+		if (bytes > pboBytes_)
+			pboBytes_ = bytes;
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, pboBytes_, nullptr, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped) {
+			memcpy(mapped, image.pixels, bytes);
+			throughPbo = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+		}
+		if (throughPbo) {
+			source = nullptr;
+		}
+		else {
+			// out of memory or a lost context: upload from the decoded pixels instead
+			std::cout << "ERROR::TEXTURE::PBO_MAP_FAILED " << image.path << std::endl;
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+	}
+	GLState::bindTexture(0, GL_TEXTURE_2D, image.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, source);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (throughPbo)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	finishMipmappedTexture();
+
+	stats_.uploaded++;
+	stats_.uploadedBytes += bytes;
+	stbi_image_free(image.pixels);
+}
+
+int TextureLoader::processUploads(size_t budgetBytes)
+{
+	std::vector<DecodedImage> batch;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats_.decodeMs = decodeMs_;
+		if (ready_.empty())
+			return 0;
+		// take images in decode order until the budget is spent, the rest waits for the next frame
+		size_t taken = 0, bytes = 0;
+		while (taken < ready_.size() && (budgetBytes == 0 || taken == 0 || bytes < budgetBytes)) {
+			const DecodedImage& image = ready_[taken++];
+			bytes += (size_t)image.width * image.height * image.components;
+		}
+		batch.assign(ready_.begin(), ready_.begin() + taken);
+		ready_.erase(ready_.begin(), ready_.begin() + taken);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (const DecodedImage& image : batch)
+		upload(image);
+	stats_.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return (int)batch.size();
+}
+
+void TextureLoader::finish()
+{
+	for (;;) {
+		processUploads();
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (decoding_ == 0 && ready_.empty())
+			break;
+		decoded_.wait(lock, [this] { return !ready_.empty() || decoding_ == 0; });
+	}
+}
+
+size_t TextureLoader::getPending() const
+{
+	return stats_.requested - stats_.uploaded - stats_.failed;
+}
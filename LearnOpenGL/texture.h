@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+// decode an image with stb_image and upload it as a mipmapped GL_TEXTURE_2D
+unsigned int loadTexture(char const * path);
+
+// Decodes images on a thread pool and uploads them on the GL thread.
+// load() returns a texture name right away that holds a 1x1 grey
+// placeholder; processUploads() later respecifies that same texture with the
+// decoded image, so the handle never changes. Uploads can go through a pixel
+// unpack buffer so the driver copies from it asynchronously.
+// The loader must be destroyed before the pool; it waits for running decodes.
+// Give it a pool that runs no parallelFor: a decode queued ahead of the
+// parallelFor helpers delays them, and parallelFor waits for its helpers.
+class TextureLoader
+{
+public:
+	struct Stats
+	{
+		unsigned int requested;
+		unsigned int uploaded;
+		unsigned int failed;
+		// summed over the workers
+		double decodeMs;
+		// on the GL thread
+		double uploadMs;
+		size_t uploadedBytes;
+	};
+
+	TextureLoader(ThreadPool& pool, bool usePbo = true);
+	~TextureLoader();
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	// GL thread only: placeholder texture now, decode queued on the pool
+	unsigned int load(const char* path);
+	// GL thread only: decode path again into an existing texture; the old
+	// image stays until the new one is uploaded, and for good if it fails
+	void reload(unsigned int texture, const char* path);
+	// GL thread only, once per frame: swap in decoded images, stopping once
+	// budgetBytes have gone up (0 uploads everything ready). Returns the count.
+	int processUploads(size_t budgetBytes = 0);
+	// block until every requested texture is decoded and uploaded
+	void finish();
+
+	// requested textures still showing their placeholder
+	size_t getPending() const;
+	const Stats& getStats() const { return stats_; }
+
+private:
+	struct DecodedImage
+	{
+		unsigned int texture;
+		std::string path;
+		unsigned char* pixels;
+		int width, height, components;
+	};
+
+	void decode(unsigned int texture, const std::string& path);
+	void upload(const DecodedImage& image);
+
+	ThreadPool& pool_;
+	bool usePbo_;
+	unsigned int pbo_;
+	size_t pboBytes_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable decoded_;
+	std::vector<DecodedImage> ready_;
+	size_t decoding_;
+	double decodeMs_;
+	Stats stats_;
+};
@@ -0,0 +1,127 @@
+#include "thread_pool.h"
+
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int workers)
+	: tasks_(16), taskHead_(0), taskCount_(0), stopping_(false)
+{
+	if (workers == 0) {
+		unsigned int hardware = std::thread::hardware_concurrency();
+		workers = hardware > 1 ? hardware - 1 : 1;
+	}
+	for (unsigned int i = 0; i < workers; i++)
+		workers_.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_all();
+	for (std::thread& worker : workers_)
+		worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (taskCount_ == tasks_.size()) {
+			// unroll the ring into a larger one
+			std::vector<std::function<void()>> grown(tasks_.size() * 2);
+			for (size_t i = 0; i < taskCount_; i++)
+				grown[i] = std::move(tasks_[(taskHead_ + i) % tasks_.size()]);
+			tasks_.swap(grown);
+			taskHead_ = 0;
+		}
+		tasks_[(taskHead_ + taskCount_) % tasks_.size()] = std::move(task);
+		taskCount_++;
+	}
+	wake_.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			wake_.wait(lock, [this] { return stopping_ || taskCount_ > 0; });
+			if (taskCount_ == 0)
+				return;
+			task = std::move(tasks_[taskHead_]);
+			tasks_[taskHead_] = nullptr;
+			taskHead_ = (taskHead_ + 1) % tasks_.size();
+			taskCount_--;
+		}
+		task();
+	}
+}
+
+namespace {
+// shared by the caller and its helpers for one parallelFor call
+struct ParallelFor
+{
+	const std::function<void(size_t, size_t)>* fn;
+	size_t count;
+	size_t chunk;
+	size_t chunks;
+	std::atomic<size_t> next;
+	size_t running;
+	std::mutex mutex;
+	std::condition_variable done;
+
+	void drain()
+	{
+		for (size_t c = next++; c < chunks; c = next++) {
+			size_t begin = c * chunk;
+			size_t end = begin + chunk < count ? begin + chunk : count;
+			(*fn)(begin, end);
+		}
+	}
+};
+}
+
+void ThreadPool::parallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& fn)
+{
+	if (count == 0)
+		return;
+	if (minChunk == 0)
+		minChunk = 1;
+	// a few chunks per thread so uneven chunks still balance
+	size_t threads = workers_.size() + 1;
+	size_t chunk = (count + threads * 4 - 1) / (threads * 4);
+	if (chunk < minChunk)
+		chunk = minChunk;
+	size_t chunks = (count + chunk - 1) / chunk;
+	if (chunks == 1) {
+		fn(0, count);
+		return;
+	}
+
+	// helpers keep claiming chunks until none are left; the state lives on this
+	// stack frame, so wait until every helper has let go of it before returning.
+	// Tasks capture a single pointer, small enough for std::function to store inline.
+	ParallelFor state;
+	state.fn = &fn;
+	state.count = count;
+	state.chunk = chunk;
+	state.chunks = chunks;
+	state.next = 0;
+	size_t helpers = chunks - 1 < workers_.size() ? chunks - 1 : workers_.size();
+	state.running = helpers;
+	ParallelFor* shared = &state;
+	for (size_t i = 0; i < helpers; i++) {
+		submit([shared]() {
+			shared->drain();
+			std::lock_guard<std::mutex> lock(shared->mutex);
+			if (--shared->running == 0)
+				shared->done.notify_one();
+		});
+	}
+	state.drain();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	state.done.wait(lock, [&] { return state.running == 0; });
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads draining one FIFO task queue.
+// parallelFor() splits a range into chunks, the calling thread works on
+// chunks too and returns once every chunk is done. The queue is a ring that
+// only grows, so steady-state parallelFor calls do not allocate. parallelFor
+// waits for helpers queued behind earlier tasks, so long-running submits
+// belong in a pool of their own.
+class ThreadPool
+{
+public:
+	// 0 picks one worker per hardware thread, minus the caller
+	explicit ThreadPool(unsigned int workers = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// run task on some worker, fire and forget
+	void submit(std::function<void()> task);
+	// call fn(begin, end) over [0, count) in chunks of at least minChunk, blocks until done
+	void parallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& fn);
+
+	unsigned int getWorkerCount() const { return (unsigned int)workers_.size(); }
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers_;
+	std::vector<std::function<void()>> tasks_;
+	size_t taskHead_;
+	size_t taskCount_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool stopping_;
+};
@@ -0,0 +1,157 @@
+#include "transform.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_SSE 1
+#endif
+
+// relative tolerance for orthogonal, equal length columns
+static const float RIGID_EPSILON = 1e-4f;
+
+static bool isRigid(const glm::vec3& c0, const glm::vec3& c1, const glm::vec3& c2)
+{
+	float l0 = glm::dot(c0, c0);
+	float tolerance = RIGID_EPSILON * l0;
+	return std::fabs(glm::dot(c0, c1)) <= tolerance
+		&& std::fabs(glm::dot(c0, c2)) <= tolerance
+		&& std::fabs(glm::dot(c1, c2)) <= tolerance
+		&& std::fabs(glm::dot(c1, c1) - l0) <= tolerance
+		&& std::fabs(glm::dot(c2, c2) - l0) <= tolerance;
+}
+
+size_t computeNormalMatricesScalar(InstanceData* instances, size_t count)
+{
+	size_t rigid = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const glm::mat4& m = instances[i].model;
+		glm::vec3 c0(m[0]), c1(m[1]), c2(m[2]);
+		glm::mat3& n = instances[i].normal;
+		if (isRigid(c0, c1, c2))
+		{
+			n = glm::mat3(c0, c1, c2);
+			rigid++;
+			continue;
+		}
+		float sign = glm::dot(c0, glm::cross(c1, c2)) < 0.0f ? -1.0f : 1.0f;
+		n = glm::mat3(glm::cross(c1, c2) * sign, glm::cross(c2, c0) * sign, glm::cross(c0, c1) * sign);
+	}
+	return rigid;
+}
+
+#ifdef TRANSFORM_SSE
+struct Vec3x4
+{
+	__m128 x, y, z;
+};
+
+static inline __m128 dot4(const Vec3x4& a, const Vec3x4& b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline Vec3x4 cross4(const Vec3x4& a, const Vec3x4& b)
+{
+	Vec3x4 r;
+	r.x = _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y));
+	r.y = _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z));
+	r.z = _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x));
+	return r;
+}
+
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 abs4(__m128 v)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// column k of four instances, transposed so each register holds one component
+static inline Vec3x4 loadColumn(const InstanceData* in, int k)
+{
+	__m128 r0 = _mm_loadu_ps(&in[0].model[k][0]);
+	__m128 r1 = _mm_loadu_ps(&in[1].model[k][0]);
+	__m128 r2 = _mm_loadu_ps(&in[2].model[k][0]);
+	__m128 r3 = _mm_loadu_ps(&in[3].model[k][0]);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	Vec3x4 c = { r0, r1, r2 };
+	return c;
+}
+
+static inline void storeColumn(InstanceData* out, int k, const Vec3x4& c)
+{
+	__m128 r0 = c.x, r1 = c.y, r2 = c.z, r3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	float lanes[4][4];
+	_mm_storeu_ps(lanes[0], r0);
+	_mm_storeu_ps(lanes[1], r1);
+	_mm_storeu_ps(lanes[2], r2);
+	_mm_storeu_ps(lanes[3], r3);
+	// mat3 columns are 12 bytes, a 16 byte store would run into the next column or instance
+	for (int i = 0; i < 4; i++)
+		memcpy(&out[i].normal[k][0], lanes[i], 3 * sizeof(float));
+}
+
+size_t computeNormalMatrices(InstanceData* instances, size_t count)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 epsilon = _mm_set1_ps(RIGID_EPSILON);
+	size_t rigid = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		InstanceData* batch = instances + i;
+		Vec3x4 c0 = loadColumn(batch, 0);
+		Vec3x4 c1 = loadColumn(batch, 1);
+		Vec3x4 c2 = loadColumn(batch, 2);
+
+		// orthogonal columns of equal length: the upper 3x3 already is the normal matrix
+		__m128 l0 = dot4(c0, c0);
+		__m128 tolerance = _mm_mul_ps(epsilon, l0);
+		__m128 rigidMask = _mm_cmple_ps(abs4(dot4(c0, c1)), tolerance);
+		rigidMask = _mm_and_ps(rigidMask, _mm_cmple_ps(abs4(dot4(c0, c2)), tolerance));
+		rigidMask = _mm_and_ps(rigidMask, _mm_cmple_ps(abs4(dot4(c1, c2)), tolerance));
+		rigidMask = _mm_and_ps(rigidMask, _mm_cmple_ps(abs4(_mm_sub_ps(dot4(c1, c1), l0)), tolerance));
+		rigidMask = _mm_and_ps(rigidMask, _mm_cmple_ps(abs4(_mm_sub_ps(dot4(c2, c2), l0)), tolerance));
+		int rigidBits = _mm_movemask_ps(rigidMask);
+		rigid += (rigidBits & 1) + ((rigidBits >> 1) & 1) + ((rigidBits >> 2) & 1) + ((rigidBits >> 3) & 1);
+
+		if (rigidBits == 0xF)
+		{
+			storeColumn(batch, 0, c0);
+			storeColumn(batch, 1, c1);
+			storeColumn(batch, 2, c2);
+			continue;
+		}
+
+		// cofactor matrix, flipped when the determinant is negative
+		Vec3x4 n0 = cross4(c1, c2);
+		Vec3x4 n1 = cross4(c2, c0);
+		Vec3x4 n2 = cross4(c0, c1);
+		__m128 sign = _mm_and_ps(dot4(c0, n0), signMask);
+		Vec3x4* columns[3] = { &n0, &n1, &n2 };
+		const Vec3x4* sources[3] = { &c0, &c1, &c2 };
+		for (int k = 0; k < 3; k++)
+		{
+			Vec3x4& n = *columns[k];
+			const Vec3x4& c = *sources[k];
+			n.x = select4(rigidMask, c.x, _mm_xor_ps(n.x, sign));
+			n.y = select4(rigidMask, c.y, _mm_xor_ps(n.y, sign));
+			n.z = select4(rigidMask, c.z, _mm_xor_ps(n.z, sign));
+			storeColumn(batch, k, n);
+		}
+	}
+	return rigid + computeNormalMatricesScalar(instances + i, count - i);
+}
+#else
+size_t computeNormalMatrices(InstanceData* instances, size_t count)
+{
+	return computeNormalMatricesScalar(instances, count);
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// one entry of the per-instance vertex buffer
+struct InstanceData
+{
+	glm::mat4 model;
+	// transpose(inverse(mat3(model))) up to scale, the shader normalizes the result
+	glm::mat3 normal;
+};
+
+// Fill InstanceData::normal from InstanceData::model for count instances.
+// Rigid transforms (rotation, translation, uniform scale, reflection) reuse
+// the upper 3x3 directly; everything else uses the cofactor matrix, which is
+// the inverse transpose without the division by the determinant. Batches of
+// four run through SSE where available. Returns how many instances were rigid.
+size_t computeNormalMatrices(InstanceData* instances, size_t count);
+
+// scalar reference path, also used for the tail of the SIMD batches
+size_t computeNormalMatricesScalar(InstanceData* instances, size_t count);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "stream_buffer.h"
+
+// compile-time check that a C++ mirror member sits where std140 puts it
+#define STD140_OFFSET(type, member, offset) \
+	static_assert(offsetof(type, member) == (offset), #type "::" #member " does not match the std140 offset")
+
+// C++ mirror of a GLSL std140 uniform block, backed by one buffer object.
+// Fill data, then upload() once per frame; every program bound to the same
+// binding point sees the new values. upload(stream) writes them into a
+// StreamBuffer instead and binds that range, without a driver side copy.
+template <typename T>
+class UniformBlock
+{
+	static_assert(std::is_standard_layout<T>::value, "uniform block mirrors must be standard layout");
+	static_assert(sizeof(T) % 16 == 0, "std140 blocks are padded to a multiple of vec4");
+
+public:
+	T data;
+
+	UniformBlock(const char* blockName, GLuint binding)
+		: data(), blockName_(blockName), binding_(binding), ubo_(0)
+	{
+		glGenBuffers(1, &ubo_);
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding_, ubo_);
+	}
+
+	~UniformBlock()
+	{
+		glDeleteBuffers(1, &ubo_);
+	}
+
+	UniformBlock(const UniformBlock&) = delete;
+	UniformBlock& operator=(const UniformBlock&) = delete;
+
+	// attach the block of the given program to this binding point, programs that do not use it are skipped
+	void bind(const Shader& shader) const
+	{
+		GLuint index = glGetUniformBlockIndex(shader.id, blockName_);
+		if (index == GL_INVALID_INDEX)
+			return;
+		GLint size = 0;
+		glGetActiveUniformBlockiv(shader.id, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		if (size > (GLint)sizeof(T))
+		{
+			std::cout << "ERROR::UNIFORM_BLOCK::SIZE_MISMATCH " << blockName_ << ": GLSL " << size
+				<< " bytes, C++ " << sizeof(T) << " bytes" << std::endl;
+		}
+		glUniformBlockBinding(shader.id, index, binding_);
+	}
+
+	void upload() const
+	{
+		// also takes the binding point back from a stream upload
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding_, ubo_);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	void upload(StreamBuffer& stream) const
+	{
+		GLintptr offset = 0;
+		void* mapped = stream.map(sizeof(T), stream.getUniformAlignment(), offset);
+		if (mapped)
+			memcpy(mapped, &data, sizeof(T));
+		stream.unmap();
+		// the ring slice holds nothing, so the block's own buffer it is
+		if (!mapped)
+			upload();
+		else
+			glBindBufferRange(GL_UNIFORM_BUFFER, binding_, stream.getBuffer(), offset, sizeof(T));
+	}
+
+	GLuint getBinding() const { return binding_; }
+
+private:
+	const char* blockName_;
+	GLuint binding_;
+	GLuint ubo_;
+};
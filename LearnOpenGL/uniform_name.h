@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+// Uniform name assembled in a fixed buffer instead of std::string concatenation,
+// so per-frame lookups of indexed names never touch the heap:
+//   UniformName<32>("pLights", 3, ".position").c_str()  ->  "pLights[3].position"
+// Everything is constexpr; text past Capacity - 1 characters is cut off, which
+// then just fails the lookup like any other unknown name.
+template <size_t Capacity>
+class UniformName
+{
+	static_assert(Capacity > 1, "a uniform name needs room for at least one character");
+
+public:
+	constexpr UniformName() : text_(), length_(0) {}
+
+	constexpr explicit UniformName(const char* name) : text_(), length_(0)
+	{
+		append(name);
+	}
+
+	// array element with an optional member: array[index]member
+	constexpr UniformName(const char* array, int index, const char* member = "") : text_(), length_(0)
+	{
+		append(array);
+		appendIndex(index);
+		append(member);
+	}
+
+	constexpr UniformName& append(const char* text)
+	{
+		while (*text && length_ + 1 < Capacity)
+			text_[length_++] = *text++;
+		text_[length_] = '\0';
+		return *this;
+	}
+
+	constexpr UniformName& appendIndex(int index)
+	{
+		char digits[12] = {};
+		int count = 0;
+		unsigned int value = index < 0 ? 0u : (unsigned int)index;
+		do {
+			digits[count++] = (char)('0' + value % 10);
+			value /= 10;
+		} while (value);
+		append("[");
+		while (count > 0 && length_ + 1 < Capacity)
+			text_[length_++] = digits[--count];
+		text_[length_] = '\0';
+		return append("]");
+	}
+
+	constexpr const char* c_str() const { return text_; }
+	constexpr size_t size() const { return length_; }
+
+private:
+	char text_[Capacity];
+	size_t length_;
+};
+
+static_assert(UniformName<32>("pLights", 12, ".position").size() == 20, "UniformName must build at compile time");